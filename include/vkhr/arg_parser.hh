@@ -48,6 +48,7 @@ namespace vkhr {
 
     private:
         const char* get_next_token();
+        const char* peek_next_token() const;
 
         bool parse_integer(Argument& argument);
         bool parse_boolean(Argument& argument);
@@ -0,0 +1,40 @@
+#ifndef VKHR_ARRAY_VIEW_HH
+#define VKHR_ARRAY_VIEW_HH
+
+#include <cstddef>
+#include <vector>
+
+namespace vkhr {
+    // Read-only window into contiguous data we don't own, e.g. a
+    // std::vector or the pages of a memory mapped file. It's up to
+    // the caller to make sure the storage outlives the view itself.
+    template<typename T>
+    class ArrayView final {
+    public:
+        ArrayView() = default;
+        ArrayView(const T* data, std::size_t size)
+                 : pointer { data }, count { size } {  }
+        ArrayView(const std::vector<T>& vector)
+                 : pointer { vector.data() }, count { vector.size() } {  }
+
+        const T* data() const { return pointer; }
+        std::size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        const T* begin() const { return pointer; }
+        const T* end()   const { return pointer + count; }
+
+        const T& front() const { return pointer[0]; }
+        const T& back()  const { return pointer[count - 1]; }
+
+        const T& operator[](std::size_t i) const { return pointer[i]; }
+
+        std::vector<T> to_vector() const { return std::vector<T>(begin(), end()); }
+
+    private:
+        const T* pointer { nullptr };
+        std::size_t count { 0 };
+    };
+}
+
+#endif
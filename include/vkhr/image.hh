@@ -65,7 +65,10 @@ namespace vkhr {
         void clear();
         void clear(const Color& color);
 
-        void copy(const std::vector<glm::dvec3>& floating_point_data, double samples);
+        // Resolves a buffer of summed samples (the alpha is ignored), and it's
+        // mirrored along x. The region is in the buffer's pixel coordinates.
+        void copy(const std::vector<glm::vec4>& floating_point_data, float samples,
+                  int first_x, int first_y, int last_x, int last_y);
 
         // TODO: support bilinear and bicubic interpolation later.
         void resize(const unsigned width, const unsigned height);
@@ -0,0 +1,50 @@
+#ifndef VKHR_MAPPED_FILE_HH
+#define VKHR_MAPPED_FILE_HH
+
+#include <vkhr/array_view.hh>
+
+#include <cstddef>
+#include <string>
+
+namespace vkhr {
+    // Maps a whole file read-only into our address space. Pages are
+    // only faulted in when touched, and are backed by the page cache
+    // so they don't count towards the heap (unlike e.g. ifstream's).
+    class MappedFile final {
+    public:
+        MappedFile() = default;
+        MappedFile(const std::string& file_path);
+        ~MappedFile() noexcept;
+
+        MappedFile(MappedFile&& mapped_file) noexcept;
+        MappedFile& operator=(MappedFile&& mapped_file) noexcept;
+
+        friend void swap(MappedFile& lhs, MappedFile& rhs);
+
+        operator bool() const;
+
+        bool map(const std::string& file_path);
+        void unmap();
+
+        const unsigned char* get_data() const;
+        std::size_t get_size() const;
+
+        // Returns an empty view if the range is out of bounds or if
+        // the offset isn't suitably aligned for T (then, copy it!).
+        template<typename T>
+        ArrayView<T> view(std::size_t offset, std::size_t count) const;
+
+    private:
+        const unsigned char* data { nullptr };
+        std::size_t size { 0 };
+    };
+
+    template<typename T>
+    ArrayView<T> MappedFile::view(std::size_t offset, std::size_t count) const {
+        if (offset + count * sizeof(T) > size || (offset % alignof(T)) != 0)
+            return ArrayView<T> {  };
+        return ArrayView<T> { reinterpret_cast<const T*>(data + offset), count };
+    }
+}
+
+#endif
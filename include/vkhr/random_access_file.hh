@@ -0,0 +1,40 @@
+#ifndef VKHR_RANDOM_ACCESS_FILE_HH
+#define VKHR_RANDOM_ACCESS_FILE_HH
+
+#include <cstddef>
+#include <string>
+
+namespace vkhr {
+    // Read-only file that supports positional reads (pread/ReadFile
+    // with an explicit offset), so several threads can read disjoint
+    // ranges of it at once without fighting over a shared file cursor.
+    class RandomAccessFile final {
+    public:
+        RandomAccessFile() = default;
+        RandomAccessFile(const std::string& file_path);
+        ~RandomAccessFile() noexcept;
+
+        RandomAccessFile(RandomAccessFile&& file) noexcept;
+        RandomAccessFile& operator=(RandomAccessFile&& file) noexcept;
+
+        friend void swap(RandomAccessFile& lhs, RandomAccessFile& rhs);
+
+        operator bool() const;
+
+        bool open(const std::string& file_path);
+        void close();
+
+        std::size_t get_size() const;
+
+        // Thread-safe, and will keep reading until size bytes are read,
+        // also retrying when the read was interrupted by a signal (EINTR).
+        bool read(void* buffer, std::size_t size, std::size_t offset) const;
+
+    private:
+        void* handle { nullptr };
+        int descriptor { -1 };
+        std::size_t size { 0 };
+    };
+}
+
+#endif
@@ -6,32 +6,125 @@
 #include <vkhr/ray_tracer/model.hh>
 #include <vkhr/ray_tracer/hair_style.hh>
 #include <vkhr/ray_tracer/ray.hh>
+#include <vkhr/ray_tracer/sampler.hh>
 
 #include <embree3/rtcore.h>
 
+#include <cstdint>
 #include <random>
+#include <vector>
 
 namespace vkhr {
     class Interface;
     class Raytracer final : public Renderer {
     public:
-        Raytracer(const SceneGraph& scene_graph);
+        Raytracer(const SceneGraph& scene_graph,
+                  embree::HairStyle::CurveType curve_type = embree::HairStyle::FlatLinear);
 
         ~Raytracer() noexcept;
 
         void load(const SceneGraph& scene_graph) override;
         void draw(const SceneGraph& scene_graph) override;
 
+        // For simulated hair: refits the style's BVH (and the instances on
+        // top) to its new vertices, instead of calling load() to rebuild it.
+        // Returns false if it's not in the scene, or its vertex count changed.
+        // Nothing moves the strands yet (switching scenes loads new styles),
+        // so it's the entry point for a simulation, not something we call.
+        bool update_vertices(const HairStyle& hair_style);
+
+        // Every light is importance sampled by how much it would contribute
+        // without shadows, so it's still one shadow ray a sample, no matter
+        // how many lights there are (but evaluating the BRDF for all of them).
         glm::vec3 light_shading(const Ray& ray, const Camera& camera,
-                                const LightSource& light,
-                                RTCIntersectContext& context);
-        float ambient_occlusion(const glm::vec3& point, RTCIntersectContext& context);
+                                IntersectContext& context,
+                                Sampler& sampler);
+
+        struct LightSelection {
+            const LightSource* light;
+            glm::vec3 shading; // divided by the probability it was picked.
+        };
+
+        LightSelection select_light(const Ray& ray, const Camera& camera, Sampler& sampler);
+
+        glm::vec3 unshadowed_shading(const Ray& ray, const Camera& camera);
+
+        // Instead of a shadow ray, hair hits can use the transmittance through
+        // the style's density volume, like the rasterizer's volume shadows do.
+        // It's smooth and cheap, and models still use shadow rays for these.
+        enum ShadowMethod {
+            RayTracedShadows  = 0,
+            VolumeDeepShadows = 1
+        };
+
+        void set_shadow_method(ShadowMethod shadow_method);
+        ShadowMethod get_shadow_method() const;
+
+        bool has_volume_shadows(const Ray& ray) const;
+        float volume_shadows(const Ray& ray, const glm::vec3& light_position) const;
+        glm::vec3 light_contribution(const Ray& ray, const Camera& camera,
+                                     const LightSource& light);
+        float ambient_occlusion(const Ray& ray, RTCIntersectContext& context,
+                                Sampler& sampler);
+
+        // A point on the light (a disk facing the surface), and a cosine-
+        // weighted direction on the hemisphere around the normal below.
+        glm::vec3 sample_light(const glm::vec3& position, const LightSource& light, Sampler& sampler) const;
+        glm::vec3 sample_ambient_occlusion(const glm::vec3& normal, Sampler& sampler) const;
+
+        // Strands don't have a normal, so we take the one in the plane that
+        // is normal to the tangent, which is facing back towards the viewer.
+        glm::vec3 get_ambient_occlusion_normal(const Ray& ray) const;
+
+        // Embree gives us the normals of instanced hits in object space.
+        // Tangents are interpolated in object space too, so we do the same.
+        void transform_normal(Ray& ray) const;
+
+        glm::vec3 surface_shading(const Ray& ray, const Camera& camera,
+                                  const LightSource& light,
+                                  bool in_shadow);
 
         Raytracer(Raytracer&& raytracer) noexcept;
         Raytracer& operator=(Raytracer&& raytracer) noexcept;
         friend void swap(Raytracer& lhs, Raytracer& rhs);
 
+        // Only used by the styles built in the next load(), so call it after.
+        void set_curve_type(embree::HairStyle::CurveType curve_type);
+        embree::HairStyle::CurveType get_curve_type() const;
+
         void toggle_shadows();
+        void toggle_ray_streams();
+
+        // Same seed, scene and camera gives the same frames (any threads).
+        void set_seed(std::uint32_t seed);
+        std::uint32_t get_seed() const;
+
+        // RMS of the standard error of each pixel's mean luminance, it goes
+        // down with 1 / sqrt(samples) when the noise is i.i.d. (and faster
+        // with stratification). 0 until we've taken at least two samples.
+        double get_convergence() const;
+        std::size_t get_sample_count() const;
+
+        // Tiles stop being sampled once their error is below the threshold,
+        // or if they haven't hit anything yet (e.g. the background), after
+        // MinimumTileSamples. Set it to 0 to keep sampling all the others.
+        void set_convergence_threshold(float threshold);
+        float get_convergence_threshold() const;
+
+        // True once every tile has stopped, so the render can be ended.
+        bool is_converged() const;
+
+        // Rays traced since the last reset, e.g. for reporting the rays/sec.
+        struct RayCount {
+            std::uint64_t primary { 0 };
+            std::uint64_t shadow  { 0 };
+            std::uint64_t ambient_occlusion { 0 };
+
+            std::uint64_t get_total() const;
+        };
+
+        const RayCount& get_ray_count() const;
+        void reset_ray_count();
 
         Image& get_framebuffer();
         void set_framebuffer(const Image& framebuffer);
@@ -52,33 +145,88 @@ namespace vkhr {
         void set_flush_to_zero();
         void set_denormal_zero();
 
+        struct Tile {
+            int first_x, first_y;
+            int last_x,  last_y;
+            std::uint32_t sample; // of this tile.
+        };
+
+        static constexpr int TileSize { 16 };
+
+        // Both return true if any of the primary rays hit something.
+        bool draw_tile(const SceneGraph& scene_graph, const Tile& tile, RayCount& ray_count);
+
+        // Traces a tile of primary rays, and then all of its shadow and AO
+        // rays, as ray streams instead of one rtcIntersect1 call per pixel.
+        bool draw_tile_streams(const SceneGraph& scene_graph, const Tile& tile, RayCount& ray_count);
+
+        // Tiles keep their own sample count, and the squared standard errors
+        // of their pixels' means (from the moments in the accumulation buffer).
+        struct TileState {
+            std::uint32_t samples { 0 };
+            bool hit_surface { false };
+            double squared_error_sum { 0.0 };
+            int pixel_count { 0 };
+        };
+
+        static constexpr std::uint32_t MinimumTileSamples { 8 };
+
+        std::vector<TileState> tile_states;
+        void update_tile_state(const Tile& tile, TileState& tile_state);
+        bool is_converged(const TileState& tile_state) const;
+
         bool shadows_on { true };
+        bool ray_streams_on { true };
         bool now_dirty { false };
 
         VisualizationMethod visualization_method { Shaded };
+        ShadowMethod shadow_method { RayTracedShadows };
+        float raycast_steps { 1024.0f }; // for the volume.
+
+        embree::HairStyle::CurveType curve_type { embree::HairStyle::FlatLinear };
 
         mutable RTCDevice device { nullptr };
         mutable RTCScene  scene  { nullptr };
 
         float ao_radius { 2.50f };
+        int ao_samples { 4 }; // per hit.
+        float light_radius { 16.0f };
         std::size_t samples { 0 };
 
-        std::vector<glm::dvec3> back_buffer;
+        // Sum of the samples' colors, and the sum of their squared luminance
+        // in w, for the variance. It's resolved by the tiles that were drawn.
+        std::vector<glm::vec4> accumulation_buffer;
+        void accumulate(std::size_t pixel, const glm::vec3& sample_color);
 
-        std::uint32_t seed { 0 };
-        float sample(float min,  float max);
-        std::uint32_t xorshift();
+        void update_convergence();
+        double convergence { 0.0 };
+        float convergence_threshold { 0.002f };
+
+        RayCount ray_count;
+
+        // Points to the scene graph's lights, which we get at every draw().
+        static constexpr std::size_t MaximumLightSources { 16 };
+        std::vector<const LightSource*> light_sources;
 
-        // "Correlated Multi-Jittered Sampling":
-        float rand_float(unsigned i, unsigned p);
-        unsigned permute(unsigned i, unsigned l, unsigned p);
-        glm::vec2 cmj(int s, int m, int n, int p);
+        std::uint32_t seed { 0 };
 
         Image framebuffer;
 
         std::vector<embree::HairStyle> hair_styles;
         std::vector<embree::Model>     models;
 
+        // Everything in the scene is an instance of a hair style or model,
+        // which has been built once per unique style, even if many share it.
+        struct Instance {
+            enum Type { HairStyle, Model } type;
+            std::size_t index; // into hair_styles or models.
+            glm::mat3 tangent_matrix;
+            glm::mat3 normal_matrix;
+            glm::mat4 inverse_model_matrix;
+        };
+
+        std::vector<Instance> instances; // by instance ID.
+
         friend class embree::HairStyle;
         friend class embree::Model;
         friend class Interface;
@@ -9,6 +9,7 @@
 
 #include <embree3/rtcore.h>
 
+#include <memory>
 #include <vector>
 
 #include <vkhr/rasterizer/hair_style.hh>
@@ -16,22 +17,76 @@
 namespace vkhr {
     class Raytracer;
     namespace embree {
+        // Like the models, a style has its own scene that's only built once,
+        // no matter how many nodes share it. Each node is then an instance
+        // of it in the raytracer's scene, which is placed by its transform.
         class HairStyle final : public Shadable {
         public:
+            // Flat linear curves are one primitive per segment (what we have
+            // in the rasterizer), while the round Bezier ones fit a cubic over
+            // SegmentsPerCurve segments, so it's fewer primitives with a tighter
+            // BVH, and the strands are round cylinders, like the ground truth.
+            enum CurveType {
+                FlatLinear  = 0,
+                RoundBezier = 1
+            };
+
+            static constexpr unsigned SegmentsPerCurve { 4 };
+
             HairStyle() = default;
 
             HairStyle(const vkhr::HairStyle& hair_style, const vkhr::Raytracer& raytracer);
             void load(const vkhr::HairStyle& hair_style, const vkhr::Raytracer& raytracer);
 
+            ~HairStyle() noexcept;
+
+            HairStyle(HairStyle&& hair_style) noexcept;
+            HairStyle& operator=(HairStyle&& hair_style) noexcept;
+            friend void swap(HairStyle& lhs, HairStyle& rhs);
+
+            // Rewrites the vertices in place, and refits the BVH to them, which
+            // is a lot cheaper than a rebuild (but the BVH quality will go down
+            // after large motions). False if the number of vertices changed.
+            bool update_vertices(const vkhr::HairStyle& hair_style);
+
+            // Returns the instance's geometry ID in the raytracer's scene.
+            unsigned instance(const glm::mat4& transform, const vkhr::Raytracer& raytracer) const;
+
             glm::vec3 shade(const Ray& surface_intersection,
                             const LightSource& light_source,
                             const Camera& projection_camera) override;
+            glm::vec3 shade(const Ray& surface_intersection,
+                            const LightSource& light_source,
+                            const Camera& projection_camera,
+                            const glm::mat3& tangent_matrix);
+
+            // In object space, use the instance's transform for world space.
             glm::vec4 get_tangent(const Ray& position) const;
 
+            // Voxelizes the strands (or re-uses the scene graph's volume) for
+            // volume_transmittance, it's slow, so only call it if it's needed.
+            void prepare_volume();
+            bool has_volume() const;
+
+            // Like volume_approximated_deep_shadows in the GLSL, but walks all
+            // of the voxels between the points (in object space) with a DDA,
+            // so the integral of densities is exact, and not a Riemann sum.
+            float volume_transmittance(const glm::vec3& position,
+                                       const glm::vec3& light_position,
+                                       float raycast_steps) const;
+
             unsigned get_geometry() const;
+            CurveType get_curve_type() const;
 
             void update_parameters(const vkhr::vulkan::HairStyle& hair_style);
 
+            // Shadow rays (with transmittances in their IntersectContext) pass
+            // through the strands, losing their opacity for each one that they
+            // hit, until there's so little light left that we call it occluded.
+            static void occlusion_filter(const RTCFilterFunctionNArguments* arguments);
+
+            static constexpr float TransmittanceEpsilon { 1.0f / 255.0f };
+
             const vkhr::HairStyle* get_pointer() const;
 
         private:
@@ -42,7 +97,18 @@ namespace vkhr {
                                  const glm::vec3& light,
                                  const glm::vec3& eye);
 
+            // Catmull-Rom splines through every SegmentsPerCurve:th vertex (and
+            // the last) of each strand, as Bezier control points. The radii are
+            // kept by interpolating the strand thicknesses in between knots.
+            static unsigned get_bezier_control_point_count(const vkhr::HairStyle& hair_style);
+            static void create_bezier_curves(const vkhr::HairStyle& hair_style,
+                                             glm::vec4* control_points,
+                                             unsigned* curve_indices);
+
             unsigned geometry { RTC_INVALID_GEOMETRY_ID };
+            unsigned vertex_count { 0 }; // of the style.
+
+            CurveType curve_type { FlatLinear };
 
             const vkhr::HairStyle* pointer { nullptr };
 
@@ -50,8 +116,19 @@ namespace vkhr {
 
             glm::vec3 hair_diffuse;
             float     hair_exponent;
+            float     hair_opacity;
+
+            // Shared with the scene graph's style if it has one already.
+            std::shared_ptr<const vkhr::HairStyle::SparseVolume> volume;
+
+            static constexpr float VolumeStrandThickness { 11.0f };
 
             std::vector<glm::vec4> position_thickness;
+
+            // Of each primitive (segment or curve), it's the filter's user data.
+            // It's never resized after load, so the pointer to it stays valid.
+            std::vector<float> primitive_opacities;
+            void update_opacities(const vkhr::HairStyle& hair_style);
         };
     }
 }
@@ -5,21 +5,37 @@
 
 #include <vkhr/ray_tracer/shadable.hh>
 
+#include <glm/glm.hpp>
+
+#include <embree3/rtcore.h>
+
 namespace vkhr {
     class Raytracer;
     namespace embree {
+        // Every model gets its own scene (and BVH) that is built only once,
+        // and then placed in the raytracer's scene by an instance for every
+        // node that uses it. Hits on these will have instance IDs set to it.
         class Model final : public Shadable {
         public:
             Model(const vkhr::Model& model,     const vkhr::Raytracer& raytracer);
             void load(const vkhr::Model& model, const vkhr::Raytracer& raytracer);
 
             Model() = default;
+            ~Model() noexcept;
+
+            Model(Model&& model) noexcept;
+            Model& operator=(Model&& model) noexcept;
+            friend void swap(Model& lhs, Model& rhs);
 
             unsigned get_geometry() const;
 
+            // Returns the instance's geometry ID in the raytracer's scene.
+            unsigned instance(const glm::mat4& transform, const vkhr::Raytracer& raytracer) const;
+
+            // Expects the normal of the hit in world space, not object space.
             glm::vec3 shade(const Ray& surface_intersection,
                             const LightSource& light_source,
-                            const Camera& projection_camera);
+                            const Camera& projection_camera) override;
         private:
             glm::vec3 blinn_phong(const glm::vec3& diffuse,
                                   const glm::vec3& specular,
@@ -31,6 +47,10 @@ namespace vkhr {
             RTCScene scene { nullptr };
 
             unsigned geometry { RTC_INVALID_GEOMETRY_ID };
+
+            glm::vec3 diffuse  { 1.0f };
+            glm::vec3 specular { 0.0f };
+            float shininess { 1.0f };
         };
     }
 }
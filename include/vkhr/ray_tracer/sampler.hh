@@ -0,0 +1,47 @@
+#ifndef VKHR_EMBREE_SAMPLER_HH
+#define VKHR_EMBREE_SAMPLER_HH
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace vkhr {
+    // Counter-based random numbers: each one only depends on the seed, the
+    // pixel, the sample index and how many were drawn before, so there's no
+    // shared state between threads, and a frame's the same for a given seed.
+    class Sampler final {
+    public:
+        Sampler(std::uint32_t seed, std::uint32_t pixel, std::uint32_t sample);
+
+        float next(); // in [0, 1).
+        float next(float min, float max);
+
+        // Stratified over each PatternSize samples of a pixel with CMJ. Use
+        // it for the 2D integrals, i.e. for pixel, light and AO samples.
+        glm::vec2 next_2d();
+
+        static constexpr unsigned PatternWidth { 8 };
+        static constexpr unsigned PatternSize  { PatternWidth * PatternWidth };
+
+        // Maps [0, 1)² to a unit disk / a hemisphere around +z (with p.d.f.
+        // cos(theta) / pi), and a basis to go from +z to around the normal.
+        static glm::vec2 to_concentric_disk(const glm::vec2& sample);
+        static glm::vec3 to_cosine_hemisphere(const glm::vec2& sample);
+        static glm::mat3 orthonormal_basis(const glm::vec3& normal);
+
+        // From: "Correlated Multi-Jittered Sampling" by Pixar:
+        static float rand_float(unsigned i, unsigned p);
+        static unsigned permute(unsigned i, unsigned l, unsigned p);
+        static glm::vec2 cmj(int s, int m, int n, int p);
+
+    private:
+        static std::uint32_t hash(std::uint32_t x);
+
+        std::uint32_t pattern;
+        std::uint32_t pixel_pattern;
+        std::uint32_t sample;
+        std::uint32_t dimension { 0 };
+    };
+}
+
+#endif
\ No newline at end of file
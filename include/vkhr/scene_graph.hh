@@ -4,6 +4,7 @@
 #include <vkhr/scene_graph/model.hh>
 #include <vkhr/scene_graph/light_source.hh>
 #include <vkhr/scene_graph/hair_style.hh>
+#include <vkhr/scene_graph/hair_cache.hh>
 #include <vkhr/scene_graph/camera.hh>
 
 #include <nlohmann/json.hpp>
@@ -57,6 +58,8 @@ namespace vkhr {
 
         const std::string& get_scene_path() const;
 
+        HairCache& get_hair_cache();
+
         void cleanup();
 
         class Node final {
@@ -190,6 +193,8 @@ namespace vkhr {
         std::unordered_map<std::string, HairStyle> hair_styles;
         std::unordered_map<std::string, Model> models;
 
+        HairCache hair_cache;
+
         std::size_t unique_name { 0 };
         std::string scene_path { "" };
 
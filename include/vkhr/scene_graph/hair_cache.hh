@@ -0,0 +1,66 @@
+#ifndef VKHR_HAIR_CACHE_HH
+#define VKHR_HAIR_CACHE_HH
+
+#include <vkhr/scene_graph/hair_style.hh>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace vkhr {
+    // Keeps "baked" copies of hair styles, that have already been shuffled
+    // and had their tangents, thickness, AABB and the volume generated, so
+    // that we can skip all of those passes on the next start-up. Entries are
+    // keyed on the style's path, modification time, size and the options.
+    class HairCache final {
+    public:
+        HairCache(const std::string& cache_directory = "cache/");
+
+        struct Options {
+            float strand_thickness;
+            glm::ivec3 volume_resolution;
+            HairStyle::Voxelizer voxelizer;
+            bool shuffle;
+        };
+
+        bool load(const std::string& style_path, const Options& options, HairStyle& hair_style) const;
+        bool save(const std::string& style_path, const Options& options, const HairStyle& hair_style) const;
+
+        // Returns 0 if the style couldn't be found (so we can't cache it).
+        std::uint64_t get_key(const std::string& style_path, const Options& options) const;
+
+        void set_enabled(bool enabled);
+        bool is_enabled() const;
+
+        void set_cache_directory(const std::string& cache_directory);
+        const std::string& get_cache_directory() const;
+
+        // Bump this whenever the baked data or how it's generated changes.
+        static constexpr std::uint32_t Version { 5 };
+
+    private:
+        std::string get_entry_path(std::uint64_t key) const;
+
+        bool load_volume(const std::string& file_path, std::uint64_t key, HairStyle::SparseVolume& volume) const;
+        bool save_volume(const std::string& file_path, std::uint64_t key, const HairStyle::SparseVolume& volume) const;
+
+        static std::uint64_t fnv1a(const void* data, std::size_t size, std::uint64_t hash);
+
+        struct VolumeHeader {
+            char signature[4]; // V, O, X, L.
+            std::uint32_t version;
+            std::uint64_t key;
+            std::int32_t resolution[3];
+            float bounds_origin[3];
+            float bounds_size[3];
+            std::int32_t brick_resolution[3];
+            std::uint32_t brick_count;
+        };
+
+        bool enabled { true };
+        std::string cache_directory;
+    };
+}
+
+#endif
@@ -7,8 +7,19 @@
 
 #include <glm/gtx/component_wise.hpp>
 
+#include <vkhr/array_view.hh>
+#include <vkhr/mapped_file.hh>
+#include <vkhr/random_access_file.hh>
+
+#include <vkhr/scene_graph/strand_range.hh>
+
 #include <string>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
 #include <fstream>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <array>
 
@@ -23,7 +34,14 @@ namespace vkhr {
     class HairStyle final {
     public:
         HairStyle() = default;
-        HairStyle(const std::string& file_path);
+
+        enum class Loader {
+            Stream,  // copies each field into the vectors.
+            Mapped,  // mmaps file, copies when field is mutated.
+            Parallel // positional reads of chunks over threads.
+        };
+
+        HairStyle(const std::string& file_path, Loader loader = Loader::Stream);
 
         enum class Error {
             None,
@@ -33,6 +51,7 @@ namespace vkhr {
             WritingFileHeader,
 
             InvalidSignature,
+            UnsupportedCompression,
 
             ReadingSegments,
             ReadingVertices,
@@ -57,7 +76,43 @@ namespace vkhr {
         Error get_last_error_state() const;
 
         bool load(const std::string& file_path);
-        bool save(const std::string& file_path) const;
+        bool map(const std::string& file_path);
+
+        // Called with the number of bytes read so far and the total bytes.
+        // It runs on the OpenMP worker threads (serialized by a critical
+        // section), so don't touch the UI or other thread-affine state in
+        // it; e.g. store the progress in an atomic and poll it from there.
+        using ProgressCallback = std::function<void(std::size_t, std::size_t)>;
+
+        // Finds the offsets of all fields from the header, and then reads
+        // them in chunk_size pieces with positional reads over all cores.
+        bool load_parallel(const std::string& file_path,
+                           const ProgressCallback& progress = nullptr,
+                           std::size_t chunk_size = 4 * 1024 * 1024);
+
+        enum class Compression {
+            None,     // full precision, readable by any .hair loader.
+            Quantized // 16-bit positions, octahedral tangents and 8-bit
+                      // thickness/transparency. Only vkhr can read them.
+        };
+
+        bool save(const std::string& file_path, Compression compression = Compression::None) const;
+
+        // Largest error introduced by quantization in the last compressed
+        // file we loaded or saved, zero if the file is in full precision.
+        struct QuantizationError {
+            float position;     // per component, in world space units.
+            float thickness;
+            float transparency;
+            float tangent;      // angle in radians.
+        };
+
+        QuantizationError get_quantization_error() const;
+
+        // Copies the fields that are still backed by the memory mapped
+        // file into their vectors, and then releases the file mapping.
+        void materialize();
+        bool is_mapped() const;
 
         unsigned get_strand_count() const;
         void set_strand_count(const unsigned strand_count);
@@ -98,10 +153,80 @@ namespace vkhr {
 
             template<typename F>
             Volume downsample(F);
+
+            enum class Filter {
+                Box, // average of the 2x2x2 voxels.
+                Max,
+                Min
+            };
+
+            // Halves the resolution (rounding up) with the filter on densities,
+            // and the density-weighted average of the tangents in each 2x2x2.
+            Volume build_mip_level(Filter filter = Filter::Box) const;
+
+            // All levels after this one, down to 1x1x1 (not including this).
+            std::vector<Volume> build_mip_chain(Filter filter = Filter::Box) const;
+        };
+
+        // Hair only fills a small part of its AABB, so we only allocate the
+        // 8³ bricks that a strand touches, and mark the other ones as empty
+        // in the brick index. Use to_dense() to get the GPU upload layout.
+        // Densities are kept in fixed-point, and only rounded for the GPU.
+        struct SparseVolume {
+            static constexpr int BrickSize { 8 };
+            static constexpr int BrickVoxels { BrickSize * BrickSize * BrickSize };
+            static constexpr unsigned EmptyBrick { 0xFFFFFFFF };
+            static constexpr float DensityScale { 256.0f };
+
+            glm::vec3 resolution;
+            AABB bounds; // world
+
+            glm::ivec3 brick_resolution { 0 };
+            std::vector<unsigned> brick_index {  };
+
+            // Densities are 8.8 fixed-point (in 1/DensityScale), so any step
+            // count up to 255 is exact, and the lengths saturate near there.
+            struct Brick {
+                std::array<std::uint16_t, BrickVoxels> densities;
+                std::array<glm::i8vec4,   BrickVoxels> tangents;
+            };
+
+            std::vector<Brick> bricks {  };
+
+            float get_density(int x, int y, int z) const;
+            glm::i8vec4 get_tangent(int x, int y, int z) const;
+
+            void normalize(); // to [0, 255], but still in 8.8 fixed-point.
+            Volume to_dense() const; // R8, with the densities rounded off.
+
+            std::size_t get_size() const;
+        };
+
+        enum class Voxelizer {
+            Stepped, // steps along the major axis, may skip some voxels.
+            Exact    // Amanatides-Woo, accumulates the length in voxels.
         };
 
+        // The densities are the number of steps that landed in each voxel
+        // for Stepped (up to 255), and the length of hair inside the voxel
+        // (in voxels) for Exact. The tangents are their weighted average.
+        // Since those lengths are mostly below 1, voxelize_segments() will
+        // normalize the Exact ones before they're rounded off to R8 values.
+
         Volume voxelize_vertices(std::size_t width, std::size_t height, std::size_t depth) const;
-        Volume voxelize_segments(std::size_t width, std::size_t height, std::size_t depth) const;
+        Volume voxelize_segments(std::size_t width, std::size_t height, std::size_t depth,
+                                 Voxelizer voxelizer = Voxelizer::Stepped) const;
+
+        SparseVolume voxelize_segments_sparse(std::size_t width, std::size_t height, std::size_t depth,
+                                              Voxelizer voxelizer = Voxelizer::Stepped) const;
+
+        // Pre-computed volume, e.g. restored from the HairCache. It's
+        // shared between copies of the style since it's quite large.
+        bool has_volume() const;
+        const SparseVolume& get_volume() const;
+        std::shared_ptr<const SparseVolume> get_shared_volume() const;
+        void set_volume(SparseVolume&& volume);
+        void clear_volume();
 
         void shuffle();
         void reduce(float ratio);
@@ -120,8 +245,39 @@ namespace vkhr {
 
         void generate_indices();
 
+        // Walks the strands from the segment counts (or the default count)
+        // with O(1) memory, so the CPU-side doesn't need the index buffer.
+        StrandRange get_strand_range() const;
+        SegmentRange get_segment_range() const;
+
+        // Line list for the GPU, from the indices if we have them already.
+        std::vector<unsigned> create_index_data() const;
+
+        // Prefix sum of the vertex count in each strand, to find any strand
+        // in O(1), e.g. in parallel loops. It's a snapshot, so generate it
+        // again if you change the segments yourself (reduce() does this).
+        void generate_strand_offsets();
+        bool has_strand_offsets() const;
+        ArrayView<unsigned> get_strand_offsets() const; // strands + 1.
+        Strand get_strand(std::size_t strand) const;
+
+        // Structure-of-arrays copy of the vertices, so CPU-side passes like
+        // the AABB and tangents can be vectorized. Also a snapshot, and it
+        // takes as much memory as the vertices, so clear it once you're done.
+        struct PositionArrays {
+            std::vector<float> x, y, z;
+        };
+
+        void generate_position_arrays();
+        bool has_position_arrays() const;
+        const PositionArrays& get_position_arrays() const;
+        void clear_position_arrays();
+
         // Let the user do what he pleases with the hair data.
         // Consistency with arrays is checked upon file write.
+        // If the style was mapped, call materialize() first!
+        // The same goes for the accessors below, since fields
+        // that are still mapped are empty; or use the views.
 
         std::vector<unsigned short> segments;
         std::vector<glm::vec3> vertices;
@@ -141,6 +297,16 @@ namespace vkhr {
         const std::vector<glm::vec3>& get_tangents() const;
         const std::vector<unsigned>&  get_indices()  const;
 
+        // Read-only views that work for both the loaded and the mapped
+        // hair styles. They are invalidated when the field is mutated.
+        ArrayView<unsigned short> get_segments_view() const;
+        ArrayView<glm::vec3> get_vertices_view() const;
+        ArrayView<float> get_thickness_view() const;
+        ArrayView<float> get_transparency_view() const;
+        ArrayView<glm::vec3> get_color_view() const;
+        ArrayView<glm::vec3> get_tangents_view() const;
+        ArrayView<unsigned> get_indices_view() const;
+
         std::size_t get_size() const;
 
     private:
@@ -159,7 +325,8 @@ namespace vkhr {
                          has_tangents     : 1,
                          has_indices      : 1,
                          has_bounding_box : 1,
-                         future_extension : 24;
+                         compression      : 4, // 0 is none.
+                         future_extension : 20;
             } field;
 
             unsigned default_segment_count;
@@ -173,6 +340,18 @@ namespace vkhr {
             float    bounding_box_max[3];
         } file_header;
 
+        // Follows right after the FileHeader if the fields are compressed.
+        struct CompressionHeader {
+            float position_scale; // of the per-vertex deltas to the roots.
+            float thickness_range[2];
+            float transparency_range[2];
+            unsigned implicit_indices; // i.e. same as generate_indices().
+        } compression_header;
+
+        static constexpr unsigned CompressionVersion { 1 };
+
+        mutable QuantizationError quantization_error {  };
+
         bool valid_signature() const;
         bool format_is_valid() const;
 
@@ -195,16 +374,92 @@ namespace vkhr {
         bool read_tangents(std::ifstream& file);
         bool read_indices(std::ifstream& file);
 
+        bool read_compression_header(std::ifstream& file);
+        bool read_quantized_vertices(std::ifstream& file);
+        bool read_quantized_thickness(std::ifstream& file);
+        bool read_quantized_transparency(std::ifstream& file);
+        bool read_quantized_tangents(std::ifstream& file);
+
+        struct FieldChunk {
+            char* data;
+            std::size_t size;
+            std::size_t offset;
+            Error error;
+        };
+
+        template<typename T>
+        bool plan_field_read(std::size_t& offset, bool has_field, std::size_t count,
+                             std::vector<T>& field, std::size_t chunk_size, std::size_t file_size,
+                             std::vector<FieldChunk>& chunks, Error error);
+
+        std::shared_ptr<const SparseVolume> prepared_volume;
+
+        std::shared_ptr<MappedFile> mapped_file;
+
+        struct MappedFields {
+            ArrayView<unsigned short> segments;
+            ArrayView<glm::vec3> vertices;
+            ArrayView<float> thickness;
+            ArrayView<float> transparency;
+            ArrayView<glm::vec3> color;
+            ArrayView<glm::vec3> tangents;
+            ArrayView<unsigned> indices;
+        } mapped;
+
+        template<typename T>
+        ArrayView<T> view_field(const std::vector<T>& field, const ArrayView<T>& mapped_field) const;
+        template<typename T>
+        void materialize_field(std::vector<T>& field, ArrayView<T>& mapped_field);
         template<typename T>
-        bool write_field(std::ofstream& file, const std::vector<T>& field) const;
+        bool map_field(std::size_t& offset, bool has_field, std::size_t count,
+                       std::vector<T>& field, ArrayView<T>& mapped_field);
 
-        bool write_segments(std::ofstream& file) const;
-        bool write_vertices(std::ofstream& file) const;
-        bool write_thickness(std::ofstream& file) const;
-        bool write_transparancy(std::ofstream& file) const;
-        bool write_color(std::ofstream& file) const;
-        bool write_tangents(std::ofstream& file) const;
-        bool write_indices(std::ofstream& file) const;
+        void release_mapping();
+
+        std::vector<unsigned> strand_offsets;
+        PositionArrays position_arrays;
+
+        void clear_strand_data();
+
+        template<typename T>
+        bool write_field(std::ofstream& file, const ArrayView<T>& field) const;
+
+        // These write the header that was passed in, which is a copy of
+        // ours, since e.g. the compression is only for the file's sake.
+
+        bool write_segments(std::ofstream& file, const FileHeader& header) const;
+        bool write_vertices(std::ofstream& file, const FileHeader& header, const CompressionHeader& compression) const;
+        bool write_thickness(std::ofstream& file, const FileHeader& header, const CompressionHeader& compression) const;
+        bool write_transparancy(std::ofstream& file, const FileHeader& header, const CompressionHeader& compression) const;
+        bool write_color(std::ofstream& file, const FileHeader& header) const;
+        bool write_tangents(std::ofstream& file, const FileHeader& header) const;
+        bool write_indices(std::ofstream& file, const FileHeader& header, const CompressionHeader& compression) const;
+
+        bool write_compression_header(std::ofstream& file, const CompressionHeader& compression) const;
+        bool write_quantized_vertices(std::ofstream& file, const FileHeader& header, const CompressionHeader& compression) const;
+        bool write_quantized_thickness(std::ofstream& file, const CompressionHeader& compression) const;
+        bool write_quantized_transparency(std::ofstream& file, const CompressionHeader& compression) const;
+        bool write_quantized_tangents(std::ofstream& file) const;
+
+        void prepare_compression_header(FileHeader& header, CompressionHeader& compression) const;
+        void update_quantization_error(const FileHeader& header, const CompressionHeader& compression) const;
+        bool has_implicit_indices() const;
+
+        static AABB get_bounding_box(const FileHeader& header);
+
+        static glm::u16vec3 quantize_root(const glm::vec3& root, const AABB& bounds);
+        static glm::vec3  dequantize_root(const glm::u16vec3& root, const AABB& bounds);
+
+        // SSE2 kernels for the bricks: average tangent x, y, z by their total
+        // weight into 8-bit, pack the weights into the fixed-point densities
+        // and round those to 8-bit for the upload (keeping any hair above 0).
+        static void resolve_tangents(const float* weights, const float* x, const float* y, const float* z,
+                                     glm::i8vec4* tangents, std::size_t count);
+        static void pack_densities(const float* weights, std::uint16_t* densities, std::size_t count);
+        static void quantize_densities(const std::uint16_t* densities, unsigned char* quantized, std::size_t count);
+
+        static glm::i8vec2 encode_octahedral(const glm::vec3& direction);
+        static glm::vec3   decode_octahedral(const glm::i8vec2& encoding);
 
         mutable Error error_state { Error::None };
     };
@@ -218,7 +473,76 @@ namespace vkhr {
     }
 
     template<typename T>
-    bool HairStyle::write_field(std::ofstream& file, const std::vector<T>& field) const {
+    bool HairStyle::plan_field_read(std::size_t& offset, bool has_field, std::size_t count,
+                                    std::vector<T>& field, std::size_t chunk_size, std::size_t file_size,
+                                    std::vector<FieldChunk>& chunks, Error error) {
+        field.clear();
+
+        if (!has_field) return true;
+
+        std::size_t field_size { count * sizeof(T) };
+
+        if (offset + field_size > file_size)
+            return false;
+
+        field.resize(count);
+
+        char* field_data { reinterpret_cast<char*>(field.data()) };
+
+        for (std::size_t chunk { 0 }; chunk < field_size; chunk += chunk_size) {
+            chunks.push_back({ field_data + chunk,
+                               std::min(chunk_size, field_size - chunk),
+                               offset + chunk,
+                               error });
+        }
+
+        offset += field_size;
+
+        return true;
+    }
+
+    template<typename T>
+    ArrayView<T> HairStyle::view_field(const std::vector<T>& field, const ArrayView<T>& mapped_field) const {
+        if (field.empty())
+            return mapped_field;
+        return ArrayView<T> { field };
+    }
+
+    template<typename T>
+    void HairStyle::materialize_field(std::vector<T>& field, ArrayView<T>& mapped_field) {
+        if (field.empty() && !mapped_field.empty())
+            field = mapped_field.to_vector();
+        mapped_field = ArrayView<T> {  };
+    }
+
+    template<typename T>
+    bool HairStyle::map_field(std::size_t& offset, bool has_field, std::size_t count,
+                              std::vector<T>& field, ArrayView<T>& mapped_field) {
+        field.clear();
+        mapped_field = ArrayView<T> {  };
+
+        if (!has_field) return true;
+
+        std::size_t field_size { count * sizeof(T) };
+
+        if (offset + field_size > mapped_file->get_size())
+            return false;
+
+        mapped_field = mapped_file->view<T>(offset, count);
+
+        // Fields after an odd segment count aren't aligned; copy those.
+        if (mapped_field.empty() && count != 0) {
+            field.resize(count);
+            std::memcpy(field.data(), mapped_file->get_data() + offset, field_size);
+        }
+
+        offset += field_size;
+
+        return true;
+    }
+
+    template<typename T>
+    bool HairStyle::write_field(std::ofstream& file, const ArrayView<T>& field) const {
         if (!file.write(reinterpret_cast<const char*>(field.data()),
                         field.size() * sizeof(field[0])))
             return false;
@@ -1,7 +1,72 @@
 #ifndef VKHR_SIMULATION_HH
 #define VKHR_SIMULATION_HH
 
+#include <vkhr/scene_graph/hair_style.hh>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <array>
+
 namespace vkhr {
+    // Keeps the strand volume of a simulated style up-to-date, without a
+    // full re-voxelization each frame. Only the strands marked dirty get
+    // their old contribution removed and their new one added back, so the
+    // cost of update() scales with the amount of motion, not the groom size.
+    // Dirty strands are found with the style's get_strand(), which would be
+    // O(n) each without offsets, so call generate_strand_offsets() first.
+    class IncrementalVoxelizer final {
+    public:
+        IncrementalVoxelizer() = default;
+        IncrementalVoxelizer(const HairStyle& hair_style, const glm::ivec3& resolution);
+
+        // From scratch, which also fixes the bounds to the style's AABB, so
+        // call it again if the hair leaves them. Every strand is walked once.
+        void voxelize(const HairStyle& hair_style, const glm::ivec3& resolution);
+
+        void mark_dirty(unsigned strand);
+        std::size_t get_dirty_strand_count() const;
+
+        // Re-voxelizes the dirty strands, and returns the number of voxels
+        // that changed. Falls back to voxelize() if the vertex count changed.
+        std::size_t update(const HairStyle& hair_style);
+
+        const HairStyle::SparseVolume& get_volume() const;
+
+    private:
+        static constexpr int BrickSize { HairStyle::SparseVolume::BrickSize };
+        static constexpr int BrickVoxels { HairStyle::SparseVolume::BrickVoxels };
+
+        // Lengths are kept in fixed-point (1/LengthUnits of a voxel) so that
+        // removing a strand cancels out adding it exactly, since floats would
+        // slowly drift away after enough frames of simulation.
+        static constexpr float LengthUnits { 1024.0f };
+
+        struct Accumulator {
+            std::array<std::int32_t, BrickVoxels> lengths;
+            std::array<glm::ivec3,   BrickVoxels> tangents;
+        };
+
+        void voxelize_strand(const Strand& strand, int sign);
+        void quantize_voxel(std::size_t brick, int voxel);
+        std::size_t find_brick(const glm::ivec3& brick);
+
+        HairStyle::SparseVolume volume;
+        std::vector<Accumulator> accumulators; // same slots as the bricks.
+
+        glm::vec3 voxel_size;
+
+        // Copy of the vertices and tangents at the time each strand was last
+        // voxelized, since that's what we need to subtract it out correctly.
+        std::vector<glm::vec3> voxelized_vertices;
+        std::vector<glm::vec3> voxelized_tangents;
+
+        std::vector<unsigned> dirty_strands;
+        std::vector<bool> is_dirty;
+
+        std::vector<std::uint32_t> changed_voxels; // slot * BrickVoxels + voxel.
+    };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,176 @@
+#ifndef VKHR_STRAND_RANGE_HH
+#define VKHR_STRAND_RANGE_HH
+
+#include <vkhr/array_view.hh>
+
+#include <cstddef>
+#include <iterator>
+
+namespace vkhr {
+    // Strands are stored back-to-back in the vertex array, so we can find
+    // each one by just keeping a running sum of the segment counts, there
+    // is no need for an index buffer when walking them from CPU-side code.
+
+    struct Strand {
+        unsigned index;
+        unsigned first_vertex;
+        unsigned segment_count;
+
+        unsigned get_vertex_count() const { return segment_count + 1; }
+        unsigned get_last_vertex() const { return first_vertex + segment_count; }
+    };
+
+    // Same as a pair in the index buffer, i.e. indices[2*i] and indices[2*i+1].
+    struct Segment {
+        unsigned strand;
+        unsigned first_vertex,
+                 second_vertex;
+    };
+
+    class StrandIterator final {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = Strand;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const Strand*;
+        using reference         = const Strand&;
+
+        StrandIterator() = default;
+        StrandIterator(const ArrayView<unsigned short>& segments, unsigned default_segment_count,
+                       unsigned strand_count, unsigned strand, unsigned first_vertex)
+                      : segments { segments }, default_segment_count { default_segment_count },
+                        strand_count { strand_count }, current { strand, first_vertex, 0 } {
+            update_segment_count();
+        }
+
+        reference operator*()  const { return current; }
+        pointer   operator->() const { return &current; }
+
+        StrandIterator& operator++() {
+            current.first_vertex += current.get_vertex_count();
+            ++current.index;
+            update_segment_count();
+            return *this;
+        }
+
+        StrandIterator operator++(int) {
+            auto previous = *this;
+            ++(*this);
+            return previous;
+        }
+
+        bool operator==(const StrandIterator& other) const { return current.index == other.current.index; }
+        bool operator!=(const StrandIterator& other) const { return current.index != other.current.index; }
+
+    private:
+        void update_segment_count() {
+            if (current.index >= strand_count) current.segment_count = 0;
+            else if (segments.empty()) current.segment_count = default_segment_count;
+            else current.segment_count = segments[current.index];
+        }
+
+        ArrayView<unsigned short> segments;
+        unsigned default_segment_count { 0 };
+        unsigned strand_count { 0 };
+        Strand current {  };
+    };
+
+    class StrandRange final {
+    public:
+        StrandRange() = default;
+        StrandRange(const ArrayView<unsigned short>& segments, unsigned default_segment_count, unsigned strand_count)
+                   : segments { segments }, default_segment_count { default_segment_count },
+                     strand_count { strand_count } {  }
+
+        StrandIterator begin() const { return { segments, default_segment_count, strand_count, 0, 0 }; }
+        StrandIterator end()   const { return { segments, default_segment_count, strand_count, strand_count, 0 }; }
+
+        std::size_t size() const { return strand_count; }
+        bool empty() const { return strand_count == 0; }
+
+    private:
+        ArrayView<unsigned short> segments;
+        unsigned default_segment_count { 0 };
+        unsigned strand_count { 0 };
+    };
+
+    class SegmentIterator final {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = Segment;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const Segment*;
+        using reference         = const Segment&;
+
+        SegmentIterator() = default;
+        SegmentIterator(const StrandIterator& strand, const StrandIterator& last_strand)
+                       : strand { strand }, last_strand { last_strand } {
+            skip_empty_strands();
+            update_segment();
+        }
+
+        reference operator*()  const { return current; }
+        pointer   operator->() const { return &current; }
+
+        SegmentIterator& operator++() {
+            if (++segment == strand->segment_count) {
+                ++strand;
+                segment = 0;
+                skip_empty_strands();
+            }
+
+            update_segment();
+
+            return *this;
+        }
+
+        SegmentIterator operator++(int) {
+            auto previous = *this;
+            ++(*this);
+            return previous;
+        }
+
+        bool operator==(const SegmentIterator& other) const {
+            return strand == other.strand && segment == other.segment;
+        }
+
+        bool operator!=(const SegmentIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        void skip_empty_strands() {
+            while (strand != last_strand && strand->segment_count == 0)
+                ++strand;
+        }
+
+        void update_segment() {
+            current.strand = strand->index;
+            current.first_vertex  = strand->first_vertex + segment;
+            current.second_vertex = current.first_vertex + 1;
+        }
+
+        StrandIterator strand, last_strand;
+        unsigned segment { 0 };
+        Segment current {  };
+    };
+
+    class SegmentRange final {
+    public:
+        SegmentRange() = default;
+        SegmentRange(const StrandRange& strands, std::size_t segment_count)
+                    : strands { strands }, segment_count { segment_count } {  }
+
+        SegmentIterator begin() const { return { strands.begin(), strands.end() }; }
+        SegmentIterator end()   const { return { strands.end(),   strands.end() }; }
+
+        std::size_t size() const { return segment_count; }
+        bool empty() const { return segment_count == 0; }
+
+    private:
+        StrandRange strands;
+        std::size_t segment_count { 0 };
+    };
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef VKHR_VOXEL_TRAVERSAL_HH
+#define VKHR_VOXEL_TRAVERSAL_HH
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vkhr {
+    // See "A Fast Voxel Traversal Algorithm for Ray Tracing" by Amanatides
+    // and Woo (1987). The segment root -> tip (in voxel space) is clipped to
+    // the voxels in [lower, upper), and visit(voxel, t_enter, t_exit) is then
+    // called once for every voxel it passes through, with its t range inside.
+
+    template<typename F>
+    void traverse_voxels(const glm::vec3& root, const glm::vec3& tip,
+                         const glm::ivec3& lower, const glm::ivec3& upper,
+                         F visit) {
+        const auto direction { tip - root };
+
+        const glm::vec3 lower_bound { lower };
+        const glm::vec3 upper_bound { upper };
+
+        float t_enter { 0.0f }, t_leave { 1.0f };
+
+        for (int axis { 0 }; axis < 3; ++axis) {
+            if (direction[axis] == 0.0f) {
+                if (root[axis] < lower_bound[axis] || root[axis] >= upper_bound[axis])
+                    t_leave = -1.0f; // Parallel to and outside of the bounds.
+            } else {
+                float t_lower { (lower_bound[axis] - root[axis]) / direction[axis] },
+                      t_upper { (upper_bound[axis] - root[axis]) / direction[axis] };
+                t_enter = std::max(t_enter, std::min(t_lower, t_upper));
+                t_leave = std::min(t_leave, std::max(t_lower, t_upper));
+            }
+        }
+
+        if (t_enter >= t_leave) return;
+
+        const auto start { root + direction * t_enter };
+
+        glm::ivec3 voxel {
+            glm::clamp(static_cast<int>(std::floor(start.x)), lower.x, upper.x - 1),
+            glm::clamp(static_cast<int>(std::floor(start.y)), lower.y, upper.y - 1),
+            glm::clamp(static_cast<int>(std::floor(start.z)), lower.z, upper.z - 1)
+        };
+
+        glm::ivec3 step;
+        glm::vec3 t_next, t_delta;
+
+        for (int axis { 0 }; axis < 3; ++axis) {
+            if (direction[axis] > 0.0f) {
+                step[axis] = +1;
+                t_delta[axis] = 1.0f / direction[axis];
+                t_next[axis]  = (voxel[axis] + 1 - root[axis]) / direction[axis];
+            } else if (direction[axis] < 0.0f) {
+                step[axis] = -1;
+                t_delta[axis] = -1.0f / direction[axis];
+                t_next[axis]  = (voxel[axis] - root[axis]) / direction[axis];
+            } else {
+                step[axis] = 0;
+                t_delta[axis] = std::numeric_limits<float>::infinity();
+                t_next[axis]  = std::numeric_limits<float>::infinity();
+            }
+        }
+
+        float t { t_enter };
+
+        while (t < t_leave) {
+            const int axis = t_next.x < t_next.y ? (t_next.x < t_next.z ? 0 : 2)
+                                                 : (t_next.y < t_next.z ? 1 : 2);
+            const float t_exit { std::min(t_next[axis], t_leave) };
+
+            visit(voxel, t, t_exit);
+
+            t = t_exit;
+
+            voxel[axis] += step[axis];
+            t_next[axis] += t_delta[axis];
+
+            if (voxel.x < lower.x || voxel.x >= upper.x ||
+                voxel.y < lower.y || voxel.y >= upper.y ||
+                voxel.z < lower.z || voxel.z >= upper.z)
+                break;
+        }
+    }
+}
+
+#endif
@@ -11,13 +11,78 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+static double milliseconds_since(const Clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Traces up to --samples frames without a window or any Vulkan, or until
+// every tile is below the --convergence threshold, and then writes it to
+// --output, so we can also run regression renders on the farm.
+static bool render_offline(vkhr::SceneGraph& scene_graph, vkhr::Raytracer& ray_tracer, const vkhr::ArgParser& argp) {
+    const int max_samples = std::max(argp["samples"].value.integer, 1);
+
+    ray_tracer.set_seed(argp["seed"].value.integer);
+    ray_tracer.set_convergence_threshold(argp["convergence"].value.floating);
+
+    if (std::string { argp["shadows"].value.string } == "volume")
+        ray_tracer.set_shadow_method(vkhr::Raytracer::VolumeDeepShadows);
+    ray_tracer.reset_ray_count();
+
+    scene_graph.traverse_nodes();
+
+    double render_time { 0.0 };
+
+    int samples { 0 };
+
+    while (samples < max_samples && !ray_tracer.is_converged()) {
+        auto sample_start = Clock::now();
+        ray_tracer.draw(scene_graph);
+        render_time += milliseconds_since(sample_start);
+        ++samples;
+    }
+
+    if (ray_tracer.is_converged())
+        std::cout << "Converged below " << ray_tracer.get_convergence_threshold() << " per tile" << std::endl;
+
+    const auto& rays = ray_tracer.get_ray_count();
+
+    std::cout << "Traced " << samples << " samples in " << render_time << " ms ("
+              << render_time / samples << " ms/sample, "
+              << rays.get_total() / (render_time * 1000.0) << " Mrays/s)" << std::endl;
+    std::cout << "Rays: " << rays.primary << " primary, " << rays.shadow << " shadow, "
+              << rays.ambient_occlusion << " ambient occlusion" << std::endl;
+    std::cout << "Std. Error: " << ray_tracer.get_convergence() << std::endl;
+
+    auto save_start = Clock::now();
+
+    if (!ray_tracer.get_framebuffer().save(argp["output"].value.string)) {
+        std::cerr << "Couldn't write " << argp["output"].value.string << std::endl;
+        return false;
+    }
+
+    std::cout << "Wrote " << argp["output"].value.string << " in "
+              << milliseconds_since(save_start) << " ms" << std::endl;
+
+    return true;
+}
+
 int main(int argc, char** argv) {
     vkhr::ArgParser argp { vkhr::arguments };
     auto scene_file = argp.parse(argc, argv);
 
     if (scene_file.empty()) scene_file = SCENE("ponytail.vkhr");
 
+    auto scene_start = Clock::now();
     vkhr::SceneGraph scene_graph { scene_file };
+    auto scene_time = milliseconds_since(scene_start);
+
     auto& camera { (scene_graph.get_camera()) };
 
     int width  = argp["x"].value.integer,
@@ -25,7 +90,24 @@ int main(int argc, char** argv) {
 
     camera.set_resolution(width, height);
 
-    vkhr::Raytracer ray_tracer { scene_graph };
+    auto build_start = Clock::now();
+    auto curve_type = std::string { argp["curves"].value.string } == "bezier" ? vkhr::embree::HairStyle::RoundBezier
+                                                                              : vkhr::embree::HairStyle::FlatLinear;
+
+    vkhr::Raytracer ray_tracer { scene_graph, curve_type };
+    auto build_time = milliseconds_since(build_start);
+
+    if (argp["headless"].value.boolean) {
+        if (!argp["raytrace"].value.boolean) {
+            std::cerr << "Only --raytrace works with --headless, the rasterizer needs a window." << std::endl;
+            return 1;
+        }
+
+        std::cout << "Loaded " << scene_file << " in " << scene_time << " ms, "
+                  << "built the BVH in " << build_time << " ms" << std::endl;
+
+        return render_offline(scene_graph, ray_tracer, argp) ? 0 : 1;
+    }
 
     const vkhr::Image vulkan_icon { IMAGE("vulkan_icon.png") };
     vkhr::Window window { width, height, "VKHR", vulkan_icon };
@@ -92,6 +92,14 @@ namespace vkhr {
         }
     }
 
+    const char* ArgParser::peek_next_token() const {
+        if (current_argument > argument_count) {
+            return nullptr;
+        } else {
+            return argument_values[current_argument];
+        }
+    }
+
     bool ArgParser::parse_integer(Argument& argument) {
         auto integer = get_next_token();
 
@@ -104,7 +112,7 @@ namespace vkhr {
     }
 
     bool ArgParser::parse_boolean(Argument& argument) {
-        auto boolean = get_next_token();
+        auto boolean = peek_next_token();
 
         if (boolean != nullptr) {
             std::string boolean_string { boolean };
@@ -112,15 +120,20 @@ namespace vkhr {
             if (boolean_string == "on" ||
                 boolean_string == "yes") {
                 argument.value.boolean = true;
+                get_next_token();
+                return true;
             } else if (boolean_string == "off" ||
                        boolean_string == "no") {
                 argument.value.boolean = false;
-            } else return false;
-
-            return true;
+                get_next_token();
+                return true;
+            }
         }
 
-        return false;
+        // Just a flag, e.g. --headless, so leave the next token alone.
+        argument.value.boolean = true;
+
+        return true;
     }
 
     bool ArgParser::parse_string(Argument& argument) {
@@ -177,5 +190,13 @@ namespace vkhr {
         { "vsync",      Argument::Type::Boolean, Argument::make_boolean(true),  "" },
         { "ui",         Argument::Type::Boolean, Argument::make_boolean(true),  "" },
         { "benchmark",  Argument::Type::Boolean, Argument::make_boolean(false), "" },
+        { "headless",   Argument::Type::Boolean, Argument::make_boolean(false), "" },
+        { "raytrace",   Argument::Type::Boolean, Argument::make_boolean(false), "" },
+        { "samples",    Argument::Type::Integer, Argument::make_integer(64),    "" },
+        { "seed",       Argument::Type::Integer, Argument::make_integer(0),     "" },
+        { "output",     Argument::Type::String,  Argument::make_string("render.png"), "" },
+        { "curves",     Argument::Type::String,  Argument::make_string("linear"),     "" },
+        { "convergence", Argument::Type::Floating, Argument::make_floating(0.002f),   "" },
+        { "shadows",    Argument::Type::String,  Argument::make_string("rays"),       "" },
     };
 }
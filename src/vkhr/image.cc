@@ -6,6 +6,8 @@
 #include <stb_image_write.h>
 #include <stb_image.h>
 
+#include <emmintrin.h>
+
 #include <ctime>
 #include <cstring>
 #include <cstdio>
@@ -88,16 +90,16 @@ namespace vkhr {
 
         if (extension == "png") error = stbi_write_png(file_path.c_str(), width, height,
                                                        Channels, image_data, 0);
-        if (extension == "bmp") error = stbi_write_bmp(file_path.c_str(), width, height,
-                                                       Channels, image_data);
-        if (extension == "tga") error = stbi_write_tga(file_path.c_str(), width, height,
-                                                       Channels, image_data);
-        if (extension == "jpg") error = stbi_write_jpg(file_path.c_str(), width, height,
-                                                       Channels, image_data,
-                                                       save_jpg_quality);
+        else if (extension == "bmp") error = stbi_write_bmp(file_path.c_str(), width, height,
+                                                            Channels, image_data);
+        else if (extension == "tga") error = stbi_write_tga(file_path.c_str(), width, height,
+                                                            Channels, image_data);
+        else if (extension == "jpg") error = stbi_write_jpg(file_path.c_str(), width, height,
+                                                            Channels, image_data,
+                                                            save_jpg_quality);
         else return false; // Specify file extension.
 
-        return !error;
+        return error != 0; // stb returns 0 on failure.
     }
 
     std::string Image::save_time() const {
@@ -194,17 +196,47 @@ namespace vkhr {
             set_pixel(i, j, color);
     }
 
-    void Image::copy(const std::vector<glm::dvec3>& buffer, double samples) {
-        #pragma omp parallel for schedule(dynamic)
-        for (int j = 0; j < get_height(); ++j)
-        for (int i = 0; i < get_width();  ++i) {
-            std::size_t pixel { i + j * get_width() };
-            set_pixel(get_width() - i - 1, j, {
-                static_cast<unsigned char>(glm::clamp(buffer[pixel].r / samples, 0.0, 1.0) * 255.0),
-                static_cast<unsigned char>(glm::clamp(buffer[pixel].g / samples, 0.0, 1.0) * 255.0),
-                static_cast<unsigned char>(glm::clamp(buffer[pixel].b / samples, 0.0, 1.0) * 255.0),
-                255
-            });
+    void Image::copy(const std::vector<glm::vec4>& buffer, float samples,
+                     int first_x, int first_y, int last_x, int last_y) {
+        const __m128 scale { _mm_set1_ps(255.0f / samples) };
+        const __m128 upper { _mm_set1_ps(255.0f) };
+        const __m128 lower { _mm_setzero_ps() };
+
+        // Keeps the RGB, and then the alpha is always set to opaque (255).
+        const __m128 color_mask { _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)) };
+        const __m128 alpha { _mm_set_ps(255.0f, 0.0f, 0.0f, 0.0f) };
+
+        auto resolve = [&](const glm::vec4& sum) {
+            __m128 color { _mm_mul_ps(_mm_loadu_ps(&sum.x), scale) };
+            color = _mm_min_ps(_mm_max_ps(color, lower), upper);
+            color = _mm_or_ps(_mm_and_ps(color, color_mask), alpha);
+            return _mm_cvttps_epi32(color); // truncates.
+        };
+
+        const int width = get_width();
+
+        for (int j = first_y; j < last_y; ++j) {
+            const glm::vec4* sums { &buffer[first_x + j * width] };
+            Color* pixels { get_pixels() + j * width };
+
+            int i { first_x };
+
+            // Four pixels at a time: pack them into 16 bytes, and then reverse
+            // their order, since the x axis of the image is mirrored to ours.
+            for (; i + 4 <= last_x; i += 4, sums += 4) {
+                __m128i packed = _mm_packus_epi16(_mm_packs_epi32(resolve(sums[0]), resolve(sums[1])),
+                                                  _mm_packs_epi32(resolve(sums[2]), resolve(sums[3])));
+                packed = _mm_shuffle_epi32(packed, _MM_SHUFFLE(0, 1, 2, 3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + width - i - 4), packed);
+            }
+
+            for (; i < last_x; ++i, ++sums) {
+                alignas(16) unsigned char color[16];
+                __m128i packed = _mm_packus_epi16(_mm_packs_epi32(resolve(*sums), _mm_setzero_si128()),
+                                                  _mm_setzero_si128());
+                _mm_store_si128(reinterpret_cast<__m128i*>(color), packed);
+                pixels[width - i - 1] = Color { color[0], color[1], color[2], color[3] };
+            }
         }
     }
 
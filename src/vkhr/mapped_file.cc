@@ -0,0 +1,120 @@
+#include <vkhr/mapped_file.hh>
+
+#ifndef   WINDOWS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+
+#include <utility>
+
+namespace vkhr {
+    MappedFile::MappedFile(const std::string& file_path) {
+        map(file_path);
+    }
+
+    MappedFile::~MappedFile() noexcept {
+        unmap();
+    }
+
+    MappedFile::MappedFile(MappedFile&& mapped_file) noexcept {
+        swap(*this, mapped_file);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& mapped_file) noexcept {
+        swap(*this, mapped_file);
+        return *this;
+    }
+
+    void swap(MappedFile& lhs, MappedFile& rhs) {
+        using std::swap;
+        swap(lhs.data, rhs.data);
+        swap(lhs.size, rhs.size);
+    }
+
+    MappedFile::operator bool() const {
+        return data != nullptr;
+    }
+
+    bool MappedFile::map(const std::string& file_path) {
+        unmap(); // if we're re-using it.
+
+#ifndef WINDOWS
+        int file = open(file_path.c_str(), O_RDONLY);
+
+        if (file == -1) return false;
+
+        struct stat file_status;
+
+        if (fstat(file, &file_status) == -1 || file_status.st_size == 0) {
+            close(file);
+            return false;
+        }
+
+        void* mapping = mmap(nullptr, file_status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+        close(file); // The mapping keeps its own reference to the file.
+
+        if (mapping == MAP_FAILED) return false;
+
+        // We usually read each of the fields front to back exactly once.
+        madvise(mapping, file_status.st_size, MADV_SEQUENTIAL);
+
+        data = static_cast<const unsigned char*>(mapping);
+        size = static_cast<std::size_t>(file_status.st_size);
+#else
+        HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER file_size;
+
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        CloseHandle(file); // The view keeps its own reference to the file.
+
+        if (mapping == nullptr) return false;
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+        CloseHandle(mapping);
+
+        if (view == nullptr) return false;
+
+        data = static_cast<const unsigned char*>(view);
+        size = static_cast<std::size_t>(file_size.QuadPart);
+#endif
+
+        return true;
+    }
+
+    void MappedFile::unmap() {
+        if (data == nullptr) return;
+
+#ifndef WINDOWS
+        munmap(const_cast<unsigned char*>(data), size);
+#else
+        UnmapViewOfFile(data);
+#endif
+
+        data = nullptr;
+        size = 0;
+    }
+
+    const unsigned char* MappedFile::get_data() const {
+        return data;
+    }
+
+    std::size_t MappedFile::get_size() const {
+        return size;
+    }
+}
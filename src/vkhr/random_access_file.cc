@@ -0,0 +1,120 @@
+#include <vkhr/random_access_file.hh>
+
+#ifndef   WINDOWS
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+
+#include <utility>
+
+namespace vkhr {
+    RandomAccessFile::RandomAccessFile(const std::string& file_path) {
+        open(file_path);
+    }
+
+    RandomAccessFile::~RandomAccessFile() noexcept {
+        close();
+    }
+
+    RandomAccessFile::RandomAccessFile(RandomAccessFile&& file) noexcept {
+        swap(*this, file);
+    }
+
+    RandomAccessFile& RandomAccessFile::operator=(RandomAccessFile&& file) noexcept {
+        swap(*this, file);
+        return *this;
+    }
+
+    void swap(RandomAccessFile& lhs, RandomAccessFile& rhs) {
+        using std::swap;
+        swap(lhs.handle, rhs.handle);
+        swap(lhs.descriptor, rhs.descriptor);
+        swap(lhs.size, rhs.size);
+    }
+
+    RandomAccessFile::operator bool() const {
+        return handle != nullptr || descriptor != -1;
+    }
+
+    bool RandomAccessFile::open(const std::string& file_path) {
+        close(); // if we're re-using it.
+
+#ifndef WINDOWS
+        descriptor = ::open(file_path.c_str(), O_RDONLY);
+
+        if (descriptor == -1) return false;
+
+        struct stat file_status;
+
+        if (fstat(descriptor, &file_status) == -1) {
+            close();
+            return false;
+        }
+
+        size = static_cast<std::size_t>(file_status.st_size);
+#else
+        HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        handle = file;
+
+        LARGE_INTEGER file_size;
+
+        if (!GetFileSizeEx(file, &file_size)) {
+            close();
+            return false;
+        }
+
+        size = static_cast<std::size_t>(file_size.QuadPart);
+#endif
+
+        return true;
+    }
+
+    void RandomAccessFile::close() {
+#ifndef WINDOWS
+        if (descriptor != -1) ::close(descriptor);
+#else
+        if (handle != nullptr) CloseHandle(handle);
+#endif
+        descriptor = -1;
+        handle = nullptr;
+        size = 0;
+    }
+
+    std::size_t RandomAccessFile::get_size() const {
+        return size;
+    }
+
+    bool RandomAccessFile::read(void* buffer, std::size_t size, std::size_t offset) const {
+        auto bytes = static_cast<char*>(buffer);
+
+        while (size != 0) {
+#ifndef WINDOWS
+            auto bytes_read = pread(descriptor, bytes, size, static_cast<off_t>(offset));
+            if (bytes_read == -1 && errno == EINTR) continue;
+            if (bytes_read <= 0) return false;
+#else
+            OVERLAPPED position {  };
+            position.Offset     = static_cast<DWORD>(offset & 0xFFFFFFFF);
+            position.OffsetHigh = static_cast<DWORD>(static_cast<unsigned long long>(offset) >> 32);
+
+            DWORD bytes_read { 0 };
+            DWORD bytes_left { size > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size) };
+            if (!ReadFile(handle, bytes, bytes_left, &bytes_read, &position) || bytes_read == 0)
+                return false;
+#endif
+            bytes  += bytes_read;
+            offset += bytes_read;
+            size   -= bytes_read;
+        }
+
+        return true;
+    }
+}
@@ -19,7 +19,7 @@ namespace vkhr {
             vertices = vk::VertexBuffer {
                 vulkan_renderer.device,
                 vulkan_renderer.command_pool,
-                hair_style.get_vertices()
+                hair_style.get_vertices_view().to_vector()
             };
 
             vk::DebugMarker::object_name(vulkan_renderer.device, vertices, VK_OBJECT_TYPE_BUFFER, "Hair Position Vertex Buffer", id);
@@ -29,7 +29,7 @@ namespace vkhr {
             tangents = vk::VertexBuffer {
                 vulkan_renderer.device,
                 vulkan_renderer.command_pool,
-                hair_style.get_tangents()
+                hair_style.get_tangents_view().to_vector()
             };
 
             vk::DebugMarker::object_name(vulkan_renderer.device, tangents, VK_OBJECT_TYPE_BUFFER, "Hair Tangent Vertex Buffer", id);
@@ -39,7 +39,7 @@ namespace vkhr {
             thickness = vk::VertexBuffer {
                 vulkan_renderer.device,
                 vulkan_renderer.command_pool,
-                hair_style.get_thickness()
+                hair_style.get_thickness_view().to_vector()
             };
 
             vk::DebugMarker::object_name(vulkan_renderer.device, thickness, VK_OBJECT_TYPE_BUFFER, "Hair Thickness Vertex Buffer", id);
@@ -49,7 +49,7 @@ namespace vkhr {
             segments = vk::IndexBuffer {
                 vulkan_renderer.device,
                 vulkan_renderer.command_pool,
-                hair_style.get_indices()
+                hair_style.create_index_data()
             };
 
             vk::DebugMarker::object_name(vulkan_renderer.device, segments, VK_OBJECT_TYPE_BUFFER, "Hair Index Buffer", id);
@@ -72,9 +72,19 @@ namespace vkhr {
 
             vk::DebugMarker::object_name(vulkan_renderer.device, parameter_buffer, VK_OBJECT_TYPE_BUFFER, "Hair Parameters Buffer", id);
 
-            auto strand_volume = hair_style.voxelize_segments(256, 256, 256);
-
-            strand_volume.normalize();
+            vkhr::HairStyle::Volume strand_volume;
+
+            // Re-use the volume that was pre-computed (or baked) by the scene graph,
+            // it's sparse, so it only needs to be expanded for the upload to the GPU.
+            if (hair_style.has_volume() && hair_style.get_volume().resolution == parameters.volume_resolution) {
+                strand_volume = hair_style.get_volume().to_dense();
+            } else {
+                strand_volume = hair_style.voxelize_segments(parameters.volume_resolution.x,
+                                                             parameters.volume_resolution.y,
+                                                             parameters.volume_resolution.z,
+                                                             vkhr::HairStyle::Voxelizer::Exact);
+                strand_volume.normalize();
+            }
 
             density_sampler = vk::Sampler {
                 vulkan_renderer.device,
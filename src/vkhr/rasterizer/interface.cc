@@ -305,6 +305,22 @@ namespace vkhr {
                     ImGui::SameLine();
                     if (ImGui::Checkbox("Shadow Rays", &ray_tracer.shadows_on))
                         ray_tracer.now_dirty = true;
+                    ImGui::Checkbox("Ray Streams", &ray_tracer.ray_streams_on);
+                    ImGui::SameLine();
+                    bool volume_shadows { ray_tracer.get_shadow_method() == Raytracer::VolumeDeepShadows };
+                    if (ImGui::Checkbox("Volume Shadows", &volume_shadows))
+                        ray_tracer.set_shadow_method(volume_shadows ? Raytracer::VolumeDeepShadows
+                                                                    : Raytracer::RayTracedShadows);
+                    ImGui::PushItemWidth(171);
+                    if (ImGui::SliderInt("AO Samples", &ray_tracer.ao_samples, 1, 16))
+                        ray_tracer.now_dirty = true;
+                    ImGui::PopItemWidth();
+                    ImGui::PushItemWidth(171);
+                    ImGui::SliderFloat("Threshold", &ray_tracer.convergence_threshold, 0.000f, 0.010f, "%.4f");
+                    ImGui::PopItemWidth();
+                    ImGui::Text("%zu Samples, %.4f Std. Error%s", ray_tracer.get_sample_count(),
+                                                                  ray_tracer.get_convergence(),
+                                                                  ray_tracer.is_converged() ? " (Done)" : "");
                     ImGui::TreePop();
                 }
 
@@ -453,6 +469,8 @@ namespace vkhr {
                                 if (raytracer_hair.get_pointer() == hair_style)
                                     raytracer_hair.update_parameters(hair);
                             }
+
+                            ray_tracer.now_dirty = true; // e.g. the shadows.
                         }
 
                         ImGui::TreePop();
@@ -9,6 +9,9 @@
 
 #include <glm/gtx/rotate_vector.hpp>
 
+#include <unordered_map>
+#include <array>
+#include <algorithm>
 #include <limits>
 #include <vector>
 #include <cmath>
@@ -25,7 +28,8 @@ namespace vkhr {
         }
     }
 
-    Raytracer::Raytracer(const SceneGraph& scene_graph) {
+    Raytracer::Raytracer(const SceneGraph& scene_graph, embree::HairStyle::CurveType curve_type)
+                        : curve_type { curve_type } {
         set_flush_to_zero();
         set_denormal_zero();
 
@@ -51,13 +55,58 @@ namespace vkhr {
 
         scene = rtcNewScene(device);
 
+        rtcSetSceneFlags(scene, RTC_SCENE_FLAG_DYNAMIC);
+
+        hair_styles.clear();
+        models.clear();
+        instances.clear();
+
+        auto add_instance = [&](Instance::Type type, std::size_t index,
+                                unsigned instance, const glm::mat4& model_matrix) {
+            if (instance >= instances.size())
+                instances.resize(instance+1);
+            instances[instance] = Instance {
+                type, index,
+                glm::mat3 { model_matrix },
+                glm::transpose(glm::inverse(glm::mat3 { model_matrix })),
+                glm::inverse(model_matrix)
+            };
+        };
+
+        std::unordered_map<const HairStyle*, std::size_t> hair_style_indices;
+
         // Load only the set of hair styles which are within the actual scene graph.
+        // Each one is only built once, and then it's instanced in all the nodes
+        // that have it, so e.g. a crowd sharing the same style has only one BVH.
         for (const auto& hair_style_node : scene_graph.get_nodes_with_hair_styles()) {
             for (const auto hair_style : hair_style_node->get_hair_styles()) {
-                auto hair = embree::HairStyle { *hair_style, *this };
-                if (hair.get_geometry() >= hair_styles.size())
-                    hair_styles.resize(hair.get_geometry()+1);
-                hair_styles[hair.get_geometry()] = std::move(hair);
+                auto hair_index = hair_style_indices.find(hair_style);
+                if (hair_index == hair_style_indices.end()) {
+                    hair_index = hair_style_indices.emplace(hair_style, hair_styles.size()).first;
+                    hair_styles.emplace_back(*hair_style, *this);
+                    if (shadow_method == VolumeDeepShadows)
+                        hair_styles.back().prepare_volume();
+                }
+
+                const auto& model_matrix = hair_style_node->get_model_matrix();
+                auto instance = hair_styles[hair_index->second].instance(model_matrix, *this);
+                add_instance(Instance::HairStyle, hair_index->second, instance, model_matrix);
+            }
+        }
+
+        std::unordered_map<const Model*, std::size_t> model_indices;
+
+        for (const auto& model_node : scene_graph.get_nodes_with_models()) {
+            for (const auto model : model_node->get_models()) {
+                auto model_index = model_indices.find(model);
+                if (model_index == model_indices.end()) {
+                    model_index = model_indices.emplace(model, models.size()).first;
+                    models.emplace_back(*model, *this);
+                }
+
+                const auto& model_matrix = model_node->get_model_matrix();
+                auto instance = models[model_index->second].instance(model_matrix, *this);
+                add_instance(Instance::Model, model_index->second, instance, model_matrix);
             }
         }
 
@@ -68,35 +117,119 @@ namespace vkhr {
             scene_graph.get_camera().get_height()
         };
 
-        back_buffer.resize(framebuffer.get_pixel_count(), glm::dvec3 { 0.0, 0.0, 0.0 });
+        accumulation_buffer.resize(framebuffer.get_pixel_count(), glm::vec4 { 0.0f });
 
         clear();
     }
 
+    bool Raytracer::update_vertices(const HairStyle& hair_style) {
+        for (auto& hair : hair_styles) {
+            if (hair.get_pointer() == &hair_style) {
+                if (!hair.update_vertices(hair_style))
+                    return false;
+
+                // Only the instances' bounds have changed.
+                rtcCommitScene(scene);
+
+                now_dirty = true;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     void Raytracer::draw(const SceneGraph& scene_graph) {
         if (now_dirty)
             clear();
 
+        light_sources.clear();
+        for (const auto& light_source : scene_graph.get_light_sources())
+            if (light_sources.size() < MaximumLightSources)
+                light_sources.push_back(&light_source);
+
+        const int width  = framebuffer.get_width(),
+                  height = framebuffer.get_height();
+
+        const int tiles_x { (width  + TileSize - 1) / TileSize },
+                  tiles_y { (height + TileSize - 1) / TileSize };
+
+        // Tiles are handed out one at a time to whichever thread is idle, so
+        // threads that got cheap background tiles take over the hairy ones.
+
+        std::uint64_t primary_rays { 0 },
+                      shadow_rays  { 0 },
+                      ambient_occlusion_rays { 0 };
+
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:primary_rays, shadow_rays, ambient_occlusion_rays)
+        for (int tile_index = 0; tile_index < tiles_x * tiles_y; ++tile_index) {
+            auto& tile_state = tile_states[tile_index];
+
+            // Done, so spend the samples on the noisy tiles instead.
+            if (is_converged(tile_state))
+                continue;
+
+            Tile tile;
+            RayCount tile_rays;
+
+            tile.first_x = (tile_index % tiles_x) * TileSize;
+            tile.first_y = (tile_index / tiles_x) * TileSize;
+            tile.last_x  = std::min(tile.first_x + TileSize, width);
+            tile.last_y  = std::min(tile.first_y + TileSize, height);
+            tile.sample  = tile_state.samples;
+
+            bool hit_surface;
+
+            if (ray_streams_on)
+                hit_surface = draw_tile_streams(scene_graph, tile, tile_rays);
+            else
+                hit_surface = draw_tile(scene_graph, tile, tile_rays);
+
+            tile_state.hit_surface = tile_state.hit_surface || hit_surface;
+            ++tile_state.samples;
+
+            framebuffer.copy(accumulation_buffer, static_cast<float>(tile_state.samples),
+                             tile.first_x, tile.first_y,
+                             tile.last_x,  tile.last_y);
+
+            update_tile_state(tile, tile_state);
+
+            primary_rays += tile_rays.primary;
+            shadow_rays  += tile_rays.shadow;
+            ambient_occlusion_rays += tile_rays.ambient_occlusion;
+        }
+
+        ray_count.primary += primary_rays;
+        ray_count.shadow  += shadow_rays;
+        ray_count.ambient_occlusion += ambient_occlusion_rays;
+
+        ++samples;
+
+        update_convergence();
+    }
+
+    bool Raytracer::draw_tile(const SceneGraph& scene_graph, const Tile& tile, RayCount& ray_count) {
         auto& viewing_plane = scene_graph.get_camera().get_viewing_plane();
 
         auto& camera = scene_graph.get_camera();
-        auto& light  = scene_graph.get_light_sources().front();
 
-        #pragma omp parallel for schedule(dynamic)
-        for (int j = 0; j < static_cast<int>(framebuffer.get_height()); ++j)
-        for (int i = 0; i < static_cast<int>(framebuffer.get_width());  ++i) {
+        const int width = framebuffer.get_width();
+
+        IntersectContext         context;
+        rtcInitIntersectContext(&context.context);
+
+        bool hit_surface { false };
+
+        for (int j = tile.first_y; j < tile.last_y; ++j)
+        for (int i = tile.first_x; i < tile.last_x; ++i) {
             float x { static_cast<float>(i) },
                   y { static_cast<float>(j) };
 
-            glm::dvec3 sample_color { 1.000, 1.000, 1.000 };
+            glm::vec3 sample_color { 1.000f, 1.000f, 1.000f };
 
-            RTCIntersectContext      context;
-            rtcInitIntersectContext(&context);
+            Sampler sampler { seed, static_cast<std::uint32_t>(i + j * width), tile.sample };
 
-            glm::vec2 jitter {
-                sample(0.0f, 1.0f),
-                sample(0.0f, 1.0f)
-            };
+            glm::vec2 jitter { sampler.next_2d() };
 
             auto direction = ((x + jitter.x) * viewing_plane.x +
                               (y + jitter.y) * viewing_plane.y +
@@ -104,43 +237,316 @@ namespace vkhr {
 
             Ray ray { viewing_plane.point, direction, 0.0000f };
 
-            if (ray.intersects(scene, context)) {
-                glm::vec3 position { ray.get_intersection_point() };
+            ++ray_count.primary;
+
+            if (ray.intersects(scene, context.context)) {
+                transform_normal(ray);
 
-                sample_color = light_shading(ray, camera, light, context);
+                hit_surface = true;
+
+                sample_color = light_shading(ray, camera, context, sampler);
+
+                if (visualization_method != AmbientOcclusion && shadows_on && !light_sources.empty() && !has_volume_shadows(ray))
+                    ++ray_count.shadow;
 
                 if (visualization_method != DirectShadows) {
-                    sample_color *= ambient_occlusion(position,  context);
+                    sample_color *= ambient_occlusion(ray, context.context, sampler);
+                    ray_count.ambient_occlusion += ao_samples;
                 }
             }
 
-            back_buffer[i + j * framebuffer.get_width()] += sample_color;
+            accumulate(i + j * width, sample_color);
         }
 
-        ++samples;
+        return hit_surface;
+    }
+
+    bool Raytracer::draw_tile_streams(const SceneGraph& scene_graph, const Tile& tile, RayCount& ray_count) {
+        auto& viewing_plane = scene_graph.get_camera().get_viewing_plane();
 
-        framebuffer.clear();
-        framebuffer.copy(back_buffer, samples);
+        auto& camera = scene_graph.get_camera();
+
+        const int width = framebuffer.get_width();
+
+        const bool trace_shadows { visualization_method != AmbientOcclusion && shadows_on && !light_sources.empty() };
+        const bool trace_ambient_occlusion { visualization_method != DirectShadows };
+
+        // Every pixel draws its numbers in the same order as in draw_tile,
+        // so both of them give the exact same image for the same seed.
+
+        std::vector<Sampler> samplers;
+        samplers.reserve(TileSize * TileSize);
+
+        std::vector<Ray> primary_rays;
+        primary_rays.reserve(TileSize * TileSize);
+
+        for (int j = tile.first_y; j < tile.last_y; ++j)
+        for (int i = tile.first_x; i < tile.last_x; ++i) {
+            samplers.emplace_back(seed, static_cast<std::uint32_t>(i + j * width), tile.sample);
+
+            glm::vec2 jitter { samplers.back().next_2d() };
+
+            auto direction = ((i + jitter.x) * viewing_plane.x +
+                              (j + jitter.y) * viewing_plane.y +
+                                               viewing_plane.z);
+
+            primary_rays.emplace_back(viewing_plane.point, direction, 0.0000f);
+        }
+
+        IntersectContext         context;
+        rtcInitIntersectContext(&context.context);
+
+        context.context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+        Ray::intersect(primary_rays, scene, context.context);
+
+        for (auto& ray : primary_rays)
+            transform_normal(ray);
+
+        // Shadow and AO rays start at the hits that we've just found, and
+        // they aren't coherent anymore, but are still batched up per tile.
+
+        context.context.flags = RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
+
+        std::vector<Ray> shadow_rays,
+                         mesh_shadow_rays, // if the hair is in a volume.
+                         ambient_occlusion_rays;
+
+        shadow_rays.reserve(primary_rays.size());
+        ambient_occlusion_rays.reserve(primary_rays.size() * ao_samples);
+
+        std::vector<glm::vec3> light_shadings; // of the lights picked.
+        light_shadings.reserve(primary_rays.size());
+
+        std::vector<int> shadow_ray_indices; // or -1 - a mesh shadow ray.
+        shadow_ray_indices.reserve(primary_rays.size());
+
+        for (std::size_t pixel { 0 }; pixel < primary_rays.size(); ++pixel) {
+            const auto& ray = primary_rays[pixel];
+
+            if (!ray.hit_surface()) continue;
+
+            auto& sampler = samplers[pixel];
+
+            auto position = ray.get_intersection_point();
+
+            if (trace_shadows) {
+                auto light_selection = select_light(ray, camera, sampler);
+                auto light_point = sample_light(position, *light_selection.light, sampler);
+                if (has_volume_shadows(ray)) {
+                    light_shadings.push_back(light_selection.shading * volume_shadows(ray, light_point));
+                    shadow_ray_indices.push_back(-1 - static_cast<int>(mesh_shadow_rays.size()));
+                    mesh_shadow_rays.emplace_back(position, light_point - position, Ray::Epsilon, 1.0f);
+                } else {
+                    shadow_ray_indices.push_back(static_cast<int>(shadow_rays.size()));
+                    shadow_rays.emplace_back(position, light_point - position, Ray::Epsilon, 1.0f);
+                    shadow_rays.back().set_id(static_cast<unsigned>(shadow_rays.size() - 1));
+                    light_shadings.push_back(light_selection.shading);
+                }
+            }
+
+            if (trace_ambient_occlusion) {
+                auto normal = get_ambient_occlusion_normal(ray);
+                // Any hit within the radius occludes, so we don't need the closest one.
+                for (int k { 0 }; k < ao_samples; ++k)
+                    ambient_occlusion_rays.emplace_back(position, sample_ambient_occlusion(normal, sampler),
+                                                        Ray::Epsilon, ao_radius);
+            }
+        }
+
+        // Only the shadow rays can go through the semi-transparent strands.
+        std::vector<ShadowTransmittance> transmittances(shadow_rays.size());
+
+        context.transmittances = transmittances.data();
+        Ray::occluded_by(shadow_rays, scene, context.context);
+        context.transmittances = nullptr;
+
+        // The volume only has the hair's shadows, the meshes still need rays.
+        context.skip_hair = true;
+        Ray::occluded_by(mesh_shadow_rays, scene, context.context);
+        context.skip_hair = false;
+
+        Ray::occluded_by(ambient_occlusion_rays, scene, context.context);
+
+        ray_count.primary += primary_rays.size();
+        ray_count.shadow  += shadow_rays.size() + mesh_shadow_rays.size();
+        ray_count.ambient_occlusion += ambient_occlusion_rays.size();
+
+        std::size_t hit { 0 }, pixel { 0 };
+
+        for (int j = tile.first_y; j < tile.last_y; ++j)
+        for (int i = tile.first_x; i < tile.last_x; ++i) {
+            const auto& ray = primary_rays[pixel++];
+
+            glm::vec3 sample_color { 1.000f, 1.000f, 1.000f };
+
+            if (ray.hit_surface()) {
+                if (!trace_shadows)
+                    sample_color = unshadowed_shading(ray, camera);
+                else if (shadow_ray_indices[hit] < 0)
+                    sample_color = mesh_shadow_rays[-1 - shadow_ray_indices[hit]].is_occluded() ? glm::vec3 { 0.0f }
+                                                                                               : light_shadings[hit];
+                else if (shadow_rays[shadow_ray_indices[hit]].is_occluded())
+                    sample_color = glm::vec3 { 0.0f };
+                else
+                    sample_color = light_shadings[hit] * transmittances[shadow_ray_indices[hit]].transmittance;
+
+                if (trace_ambient_occlusion) {
+                    int unoccluded { 0 };
+                    for (int k { 0 }; k < ao_samples; ++k)
+                        if (!ambient_occlusion_rays[hit * ao_samples + k].is_occluded())
+                            ++unoccluded;
+                    sample_color *= unoccluded / static_cast<float>(ao_samples);
+                }
+
+                ++hit;
+            }
+
+            accumulate(i + j * width, sample_color);
+        }
+
+        return hit != 0;
     }
 
-    glm::vec3 Raytracer::light_shading(const Ray& ray, const Camera& camera, const LightSource& light, RTCIntersectContext& context) {
-        glm::vec3 light_jitter {
-            sample(-16.0f, 16.0f),
-            sample(-16.0f, 16.0f),
-            sample(-16.0f, 16.0f)
-        };
+    glm::vec3 Raytracer::light_shading(const Ray& ray, const Camera& camera, IntersectContext& context, Sampler& sampler) {
+        if (visualization_method == AmbientOcclusion || !shadows_on || light_sources.empty())
+            return unshadowed_shading(ray, camera);
+
+        auto position = ray.get_intersection_point();
+
+        auto light_selection = select_light(ray, camera, sampler);
+        auto light_point = sample_light(position, *light_selection.light, sampler);
 
+        // The ray ends at the light, so anything behind it won't occlude.
         Ray shadow_ray {
-            ray.get_intersection_point(),
-            light.get_spotlight_origin() + light_jitter,
-            Ray::Epsilon
+            position,
+            light_point - position,
+            Ray::Epsilon,
+            1.0f
         };
 
+        // The volume only has the hair's shadows, the meshes still need one.
+        if (has_volume_shadows(ray)) {
+            context.skip_hair = true;
+            bool in_shadow { shadow_ray.occluded_by(scene, context.context) };
+            context.skip_hair = false;
+
+            if (in_shadow)
+                return glm::vec3 { 0.0f };
+
+            return light_selection.shading * volume_shadows(ray, light_point);
+        }
+
+        // The only one, so it's the first slot of the transmittances.
+        shadow_ray.set_id(0);
+
+        ShadowTransmittance transmittance;
+
+        context.transmittances = &transmittance;
+        bool in_shadow { shadow_ray.occluded_by(scene, context.context) };
+        context.transmittances = nullptr;
+
+        if (in_shadow)
+            return glm::vec3 { 0.0f };
+
+        return light_selection.shading * transmittance.transmittance;
+    }
+
+    void Raytracer::set_shadow_method(ShadowMethod shadow_method) {
+        if (shadow_method == VolumeDeepShadows)
+            for (auto& hair_style : hair_styles)
+                hair_style.prepare_volume();
+        this->shadow_method = shadow_method;
+        now_dirty = true;
+    }
+
+    Raytracer::ShadowMethod Raytracer::get_shadow_method() const {
+        return shadow_method;
+    }
+
+    bool Raytracer::has_volume_shadows(const Ray& ray) const {
+        if (shadow_method != VolumeDeepShadows)
+            return false;
+        const auto& instance = instances[ray.get_instance_id()];
+        return instance.type == Instance::HairStyle && hair_styles[instance.index].has_volume();
+    }
+
+    float Raytracer::volume_shadows(const Ray& ray, const glm::vec3& light_position) const {
+        const auto& instance = instances[ray.get_instance_id()];
+
+        // The volume is in the style's space, not where the node has put it.
+        glm::vec3 position { instance.inverse_model_matrix * glm::vec4 { ray.get_intersection_point(), 1.0f } };
+        glm::vec3 light    { instance.inverse_model_matrix * glm::vec4 { light_position, 1.0f } };
+
+        return hair_styles[instance.index].volume_transmittance(position, light, raycast_steps);
+    }
+
+    glm::vec3 Raytracer::unshadowed_shading(const Ray& ray, const Camera& camera) {
+        if (visualization_method == AmbientOcclusion)
+            return glm::vec3 { 1.0f };
+
+        glm::vec3 shading { 0.0f };
+        for (const auto light_source : light_sources)
+            shading += light_contribution(ray, camera, *light_source);
+        return shading;
+    }
+
+    glm::vec3 Raytracer::light_contribution(const Ray& ray, const Camera& camera, const LightSource& light) {
+        // Shadow visualizations are the fraction of the lights that are visible.
+        if (visualization_method != Shaded)
+            return glm::vec3 { 1.0f / light_sources.size() };
+        return surface_shading(ray, camera, light, false);
+    }
+
+    Raytracer::LightSelection Raytracer::select_light(const Ray& ray, const Camera& camera, Sampler& sampler) {
+        std::array<glm::vec3, MaximumLightSources> contributions;
+        std::array<float, MaximumLightSources> weights;
+
+        float total_weight { 0.0f };
+
+        // Without shadows we know exactly how much every light would give, so
+        // pick one proportionally to that, and only the visibility is noisy.
+        for (std::size_t l { 0 }; l < light_sources.size(); ++l) {
+            contributions[l] = light_contribution(ray, camera, *light_sources[l]);
+            weights[l] = std::max(glm::dot(contributions[l], glm::vec3 { 0.2126f, 0.7152f, 0.0722f }), 0.0f);
+            total_weight += weights[l];
+        }
+
+        float u { sampler.next() };
+
+        if (total_weight <= 0.0f) {
+            // None of them light it up, but we still want the same rays.
+            auto l = std::min(static_cast<std::size_t>(u * light_sources.size()), light_sources.size() - 1);
+            return LightSelection { light_sources[l], glm::vec3 { 0.0f } };
+        }
+
+        float target { u * total_weight },
+              cumulative_weight { 0.0f };
+
+        std::size_t selected { 0 };
+
+        for (std::size_t l { 0 }; l < light_sources.size(); ++l) {
+            if (weights[l] <= 0.0f) continue;
+            selected = l; // in case of round-off at the end.
+            cumulative_weight += weights[l];
+            if (target < cumulative_weight)
+                break;
+        }
+
+        float probability { weights[selected] / total_weight };
+
+        return LightSelection { light_sources[selected], contributions[selected] / probability };
+    }
+
+    glm::vec3 Raytracer::surface_shading(const Ray& ray, const Camera& camera, const LightSource& light, bool in_shadow) {
         if (visualization_method == AmbientOcclusion) {
             return glm::vec3 { 1.0f };
-        } else if (!shadow_ray.occluded_by(scene, context) || !shadows_on) {
+        } else if (!in_shadow) {
             if (visualization_method == Shaded) {
-                return hair_styles[ray.get_geometry_id()].shade(ray, light, camera);
+                const auto& instance = instances[ray.get_instance_id()];
+                if (instance.type == Instance::Model)
+                    return models[instance.index].shade(ray, light, camera);
+                return hair_styles[instance.index].shade(ray, light, camera, instance.tangent_matrix);
             } else {
                 return glm::vec3 { 1.0f };
             }
@@ -149,23 +555,149 @@ namespace vkhr {
         }
     }
 
-    float Raytracer::ambient_occlusion(const glm::vec3& position, RTCIntersectContext& context) {
-        auto random_direction = glm::vec3 {
-            sample(-1.0f, +1.0f),
-            sample(-1.0f, +1.0f),
-            sample(-1.0f, +1.0f)
-        };
+    float Raytracer::ambient_occlusion(const Ray& ray, RTCIntersectContext& context, Sampler& sampler) {
+        auto position = ray.get_intersection_point();
+        auto normal = get_ambient_occlusion_normal(ray);
 
-        Ray random_ray {
-            position,
-            random_direction,
-            Ray::Epsilon
-        };
+        // These end at the AO radius, so Embree can stop at any hit before it,
+        // instead of finding the closest hit and only then checking distance.
+
+        std::vector<Ray> random_rays;
+        random_rays.reserve(ao_samples);
+
+        for (int k { 0 }; k < ao_samples; ++k)
+            random_rays.emplace_back(position, sample_ambient_occlusion(normal, sampler),
+                                     Ray::Epsilon, ao_radius);
+
+        Ray::occluded_by(random_rays, scene, context);
+
+        int unoccluded { 0 };
+        for (const auto& random_ray : random_rays)
+            if (!random_ray.is_occluded())
+                ++unoccluded;
+
+        return unoccluded / static_cast<float>(ao_samples);
+    }
+
+    glm::vec3 Raytracer::sample_light(const glm::vec3& position, const LightSource& light, Sampler& sampler) const {
+        auto light_origin = light.get_spotlight_origin();
+        auto light_normal = glm::normalize(position - light_origin);
+        auto disk = Sampler::to_concentric_disk(sampler.next_2d()) * light_radius;
+        return light_origin + Sampler::orthonormal_basis(light_normal) * glm::vec3 { disk, 0.0f };
+    }
+
+    glm::vec3 Raytracer::sample_ambient_occlusion(const glm::vec3& normal, Sampler& sampler) const {
+        auto direction = Sampler::to_cosine_hemisphere(sampler.next_2d());
+        return Sampler::orthonormal_basis(normal) * direction;
+    }
+
+    glm::vec3 Raytracer::get_ambient_occlusion_normal(const Ray& ray) const {
+        auto eye = -glm::normalize(ray.get_direction());
+
+        const auto& instance = instances[ray.get_instance_id()];
+
+        if (instance.type == Instance::HairStyle) {
+            auto tangent = instance.tangent_matrix * glm::vec3 { hair_styles[instance.index].get_tangent(ray) };
+            if (glm::dot(tangent, tangent) > Ray::Epsilon) {
+                tangent = glm::normalize(tangent);
+                auto normal = eye - glm::dot(eye, tangent) * tangent;
+                if (glm::dot(normal, normal) > Ray::Epsilon)
+                    return glm::normalize(normal);
+            }
+        }
 
-        if (!random_ray.occluded_by(scene, context, ao_radius))
-            return 2.0f;
-        else
-            return 0.0f;
+        // Looking down the strand, or it's not a strand, so use the surface.
+        auto normal = glm::normalize(ray.get_normal());
+        return glm::dot(normal, eye) < 0.0f ? -normal : normal;
+    }
+
+    void Raytracer::transform_normal(Ray& ray) const {
+        if (ray.hit_instance())
+            ray.set_normal(instances[ray.get_instance_id()].normal_matrix * ray.get_normal());
+    }
+
+    void Raytracer::accumulate(std::size_t pixel, const glm::vec3& sample_color) {
+        float luminance { glm::dot(sample_color, glm::vec3 { 0.2126f, 0.7152f, 0.0722f }) };
+        accumulation_buffer[pixel] += glm::vec4 { sample_color, luminance * luminance };
+    }
+
+    void Raytracer::update_tile_state(const Tile& tile, TileState& tile_state) {
+        const int width = framebuffer.get_width();
+
+        tile_state.pixel_count = (tile.last_x - tile.first_x) * (tile.last_y - tile.first_y);
+        tile_state.squared_error_sum = 0.0;
+
+        if (tile_state.samples < 2)
+            return;
+
+        const double n { static_cast<double>(tile_state.samples) };
+
+        for (int j = tile.first_y; j < tile.last_y; ++j)
+        for (int i = tile.first_x; i < tile.last_x; ++i) {
+            const glm::dvec4 sums { accumulation_buffer[i + j * width] };
+            double mean { glm::dot(glm::dvec3 { sums }, glm::dvec3 { 0.2126, 0.7152, 0.0722 }) / n };
+            double variance { std::max(sums.w / n - mean * mean, 0.0) * n / (n - 1.0) };
+            tile_state.squared_error_sum += variance / n; // of the mean.
+        }
+    }
+
+    bool Raytracer::is_converged(const TileState& tile_state) const {
+        if (tile_state.samples < MinimumTileSamples)
+            return false;
+        if (!tile_state.hit_surface)
+            return true;
+        if (convergence_threshold <= 0.0f)
+            return false;
+
+        // The RMS error of its pixels, since a single firefly shouldn't keep
+        // the whole tile alive, but a noisy silhouette or shadow edge should.
+        double tile_error { std::sqrt(tile_state.squared_error_sum / tile_state.pixel_count) };
+
+        return tile_error <= convergence_threshold;
+    }
+
+    bool Raytracer::is_converged() const {
+        return std::all_of(tile_states.begin(), tile_states.end(), [&](const TileState& tile_state) {
+            return is_converged(tile_state);
+        });
+    }
+
+    void Raytracer::update_convergence() {
+        double squared_error_sum { 0.0 };
+
+        // The tiles that weren't drawn still have the error they stopped at.
+        for (const auto& tile_state : tile_states)
+            squared_error_sum += tile_state.squared_error_sum;
+
+        convergence = std::sqrt(squared_error_sum / accumulation_buffer.size());
+    }
+
+    void Raytracer::set_convergence_threshold(float threshold) {
+        convergence_threshold = threshold;
+    }
+
+    float Raytracer::get_convergence_threshold() const {
+        return convergence_threshold;
+    }
+
+    double Raytracer::get_convergence() const {
+        return convergence;
+    }
+
+    std::size_t Raytracer::get_sample_count() const {
+        return samples;
+    }
+
+    std::uint64_t Raytracer::RayCount::get_total() const {
+        return primary + shadow + ambient_occlusion;
+    }
+
+    const Raytracer::RayCount& Raytracer::get_ray_count() const {
+        return ray_count;
+    }
+
+    void Raytracer::reset_ray_count() {
+        ray_count = RayCount {  };
     }
 
     Image& Raytracer::get_framebuffer() {
@@ -182,9 +714,14 @@ namespace vkhr {
 
     void Raytracer::clear() {
         samples = 0;
-        std::fill(back_buffer.begin(),
-                  back_buffer.end(),
-                  glm::vec3 { 0.0 });
+        std::fill(accumulation_buffer.begin(),
+                  accumulation_buffer.end(),
+                  glm::vec4 { 0.0f });
+        const int width  = framebuffer.get_width(),
+                  height = framebuffer.get_height();
+        tile_states.assign(((width  + TileSize - 1) / TileSize) *
+                           ((height + TileSize - 1) / TileSize), TileState { });
+        convergence = 0.0;
         now_dirty = false;
     }
 
@@ -194,7 +731,7 @@ namespace vkhr {
             height
         };
 
-        back_buffer.resize(framebuffer.get_pixel_count(), glm::dvec3 { 0.0, 0.0, 0.0 });
+        accumulation_buffer.resize(framebuffer.get_pixel_count(), glm::vec4 { 0.0f });
 
         clear();
     }
@@ -203,6 +740,27 @@ namespace vkhr {
         shadows_on = !shadows_on;
     }
 
+    void Raytracer::toggle_ray_streams() {
+        ray_streams_on = !ray_streams_on;
+    }
+
+    void Raytracer::set_seed(std::uint32_t seed) {
+        this->seed = seed;
+        now_dirty = true;
+    }
+
+    void Raytracer::set_curve_type(embree::HairStyle::CurveType curve_type) {
+        this->curve_type = curve_type;
+    }
+
+    embree::HairStyle::CurveType Raytracer::get_curve_type() const {
+        return curve_type;
+    }
+
+    std::uint32_t Raytracer::get_seed() const {
+        return seed;
+    }
+
     Raytracer::Raytracer(Raytracer&& raytracer) noexcept {
         swap(*this, raytracer);
     }
@@ -224,84 +782,4 @@ namespace vkhr {
     void Raytracer::set_denormal_zero() {
         _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
     }
-
-    std::uint32_t Raytracer::xorshift() {
-        std::uint32_t x = seed;
-        x ^= x << 13;
-        x ^= x >> 7;
-        x ^= x << 17;
-        seed = x;
-        return x;
-    }
-
-    float Raytracer::sample(float min, float max) {
-        float random_number = xorshift();
-        float range = max - min;
-        float normalization = std::numeric_limits<std::uint32_t>::max();
-        return (random_number / normalization) * range + min;
-    }
-
-    // From: "Correlated Multi-Jitter Sampling" by Pixar:
-
-    float Raytracer::rand_float(unsigned i, unsigned p) {
-        i ^= p;
-        i ^= i >> 17;
-        i ^= i >> 10;
-        i *= 0xb36534e5;
-        i ^= i >> 12;
-        i ^= i >> 21;
-        i *= 0x93fc4795;
-        i ^= 0xdf6e307f;
-        i ^= i >> 17;
-        i *= 1 | p >> 18;
-        return i * (1.0f / 4294967808.0f);
-    }
-
-    unsigned Raytracer::permute(unsigned i, unsigned l, unsigned p) {
-        unsigned w = l - 1;
-
-        w |= w >> 1;
-        w |= w >> 2;
-        w |= w >> 4;
-        w |= w >> 8;
-        w |= w >> 16;
-
-        do {
-            i ^= p;
-            i *= 0xe170893d;
-            i ^= p >> 16;
-            i ^= (i & w) >> 4;
-            i ^= p >> 8;
-            i *= 0x0929eb3f;
-            i ^= p >> 23;
-            i ^= (i & w) >> 1;
-            i *= 1 | p >> 27;
-            i *= 0x6935fa69;
-            i ^= (i & w) >> 11;
-            i *= 0x74dcb303;
-            i ^= (i & w) >> 2;
-            i *= 0x9e501cc3;
-            i ^= (i & w) >> 2;
-            i *= 0xc860a3df;
-            i &= w;
-            i ^= i >> 5;
-        } while (i >= l);
-
-        return (i + p) % l;
-    }
-
-    glm::vec2 Raytracer::cmj(int s, int m, int n, int p) {
-        int sx = permute(s % m, m, p * 0xa511e9b3),
-            sy = permute(s / m, n, p * 0x63d83595);
-
-        float jx = rand_float(s, p * 0xa399d265),
-              jy = rand_float(s, p * 0x711ad6a5);
-
-        glm::vec2 r = {
-            (s % m + (sy + jx) / n) / m,
-            (s / m + (sx + jy) / m) / n
-        };
-
-        return r;
-    }
 }
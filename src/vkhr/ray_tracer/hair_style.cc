@@ -2,6 +2,14 @@
 
 #include <vkhr/ray_tracer.hh>
 
+#include <vkhr/scene_graph/voxel_traversal.hh>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
 namespace vkhr {
     namespace embree {
         HairStyle::HairStyle(const vkhr::HairStyle& hair_style,
@@ -9,48 +17,182 @@ namespace vkhr {
             load(hair_style, raytracer);
         }
 
+        HairStyle::~HairStyle() noexcept {
+            if (scene != nullptr)
+                rtcReleaseScene(scene);
+        }
+
+        HairStyle::HairStyle(HairStyle&& hair_style) noexcept {
+            swap(*this, hair_style);
+        }
+
+        HairStyle& HairStyle::operator=(HairStyle&& hair_style) noexcept {
+            swap(*this, hair_style);
+            return *this;
+        }
+
+        void swap(HairStyle& lhs, HairStyle& rhs) {
+            using std::swap;
+            swap(lhs.geometry,           rhs.geometry);
+            swap(lhs.vertex_count,       rhs.vertex_count);
+            swap(lhs.curve_type,         rhs.curve_type);
+            swap(lhs.pointer,            rhs.pointer);
+            swap(lhs.scene,              rhs.scene);
+            swap(lhs.hair_diffuse,       rhs.hair_diffuse);
+            swap(lhs.hair_exponent,      rhs.hair_exponent);
+            swap(lhs.hair_opacity,       rhs.hair_opacity);
+            swap(lhs.volume,             rhs.volume);
+            swap(lhs.position_thickness, rhs.position_thickness);
+            swap(lhs.primitive_opacities, rhs.primitive_opacities);
+        }
+
         void HairStyle::load(const vkhr::HairStyle& hair_style,
                              const vkhr::Raytracer& raytracer) {
-            const auto& indices = hair_style.get_indices();
+            if (scene != nullptr)
+                rtcReleaseScene(scene);
+
+            scene = rtcNewScene(raytracer.device);
+
+            // The vertices may be simulated, so we only refit the BVH later.
+            rtcSetSceneFlags(scene, RTC_SCENE_FLAG_DYNAMIC);
 
-            position_thickness = hair_style.create_position_thickness_data();
+            curve_type = raytracer.curve_type;
+            vertex_count = hair_style.get_vertex_count();
 
-            auto hair_geometry = rtcNewGeometry(raytracer.device, RTC_GEOMETRY_TYPE_FLAT_LINEAR_CURVE);
+            RTCGeometry hair_geometry;
+
+            if (curve_type == RoundBezier) {
+                hair_geometry = rtcNewGeometry(raytracer.device, RTC_GEOMETRY_TYPE_ROUND_BEZIER_CURVE);
+
+                position_thickness.resize(get_bezier_control_point_count(hair_style));
+
+                auto curve_count = (position_thickness.size() - hair_style.get_strand_count()) / 3;
+
+                // Bezier curves need the first of their four control points.
+                auto curve_indices = static_cast<unsigned*>(rtcSetNewGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT,
+                                                                                    sizeof(unsigned), curve_count));
+
+                create_bezier_curves(hair_style, position_thickness.data(), curve_indices);
+            } else {
+                hair_geometry = rtcNewGeometry(raytracer.device, RTC_GEOMETRY_TYPE_FLAT_LINEAR_CURVE);
+
+                position_thickness = hair_style.create_position_thickness_data();
+
+                rtcSetGeometryVertexAttributeCount(hair_geometry, 1);
+
+                rtcSetSharedGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, RTC_FORMAT_FLOAT3,
+                                           hair_style.get_tangents_view().data(),
+                                           0, sizeof(glm::vec3),
+                                           hair_style.get_tangents_view().size());
+
+                // Linear curves only need the first vertex of each segment.
+                auto segment_indices = static_cast<unsigned*>(rtcSetNewGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT,
+                                                                                      sizeof(unsigned), hair_style.get_segment_count()));
+
+                for (const auto& segment : hair_style.get_segment_range())
+                    *segment_indices++ = segment.first_vertex;
+            }
+
+            rtcSetGeometryBuildQuality(hair_geometry, RTC_BUILD_QUALITY_REFIT);
 
             rtcSetSharedGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT4,
                                        position_thickness.data(),
                                        0, sizeof(position_thickness[0]),
                                        position_thickness.size());
 
-            rtcSetGeometryVertexAttributeCount(hair_geometry, 1);
-
-            rtcSetSharedGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, RTC_FORMAT_FLOAT3,
-                                       hair_style.tangents.data(),
-                                       0, sizeof(hair_style.tangents[0]),
-                                       hair_style.tangents.size());
-
-            rtcSetSharedGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT,
-                                       indices.data(),
-                                       0, sizeof(indices[0]) * 2,
-                                       indices.size() / 2);
-
-            scene = raytracer.scene;
             pointer = &hair_style;
 
             hair_diffuse  = hair_style.get_default_color();
             hair_exponent = 50.0f;
+            hair_opacity  = hair_style.get_default_transparency();
+
+            volume.reset();
+
+            primitive_opacities.clear();
+            update_opacities(hair_style);
+
+            rtcSetGeometryUserData(hair_geometry, primitive_opacities.data());
+            rtcSetGeometryOccludedFilterFunction(hair_geometry, occlusion_filter);
 
             rtcCommitGeometry(hair_geometry);
-            geometry = rtcAttachGeometry(raytracer.scene, hair_geometry);
+            geometry = rtcAttachGeometry(scene, hair_geometry);
             rtcReleaseGeometry(hair_geometry);
+
+            rtcCommitScene(scene);
+        }
+
+        bool HairStyle::update_vertices(const vkhr::HairStyle& hair_style) {
+            if (hair_style.get_vertex_count() != vertex_count)
+                return false;
+
+            auto hair_geometry = rtcGetGeometry(scene, geometry);
+
+            if (curve_type == RoundBezier) {
+                // Same strands, so the curve indices are still the same ones.
+                create_bezier_curves(hair_style, position_thickness.data(), nullptr);
+                rtcUpdateGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_VERTEX, 0);
+                rtcCommitGeometry(hair_geometry);
+                rtcCommitScene(scene);
+                return true;
+            }
+
+            const auto vertex_view = hair_style.get_vertices_view();
+            const auto thickness_view = hair_style.get_thickness_view();
+
+            #pragma omp parallel for schedule(static)
+            for (int i = 0; i < static_cast<int>(position_thickness.size()); ++i) {
+                position_thickness[i].x = vertex_view[i].x;
+                position_thickness[i].y = vertex_view[i].y;
+                position_thickness[i].z = vertex_view[i].z;
+                if (hair_style.has_thickness())
+                    position_thickness[i].w = thickness_view[i];
+            }
+
+            // Tangents are shared with the style, but it might have moved them.
+            rtcSetSharedGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, RTC_FORMAT_FLOAT3,
+                                       hair_style.get_tangents_view().data(),
+                                       0, sizeof(glm::vec3),
+                                       hair_style.get_tangents_view().size());
+
+            rtcUpdateGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_VERTEX, 0);
+            rtcUpdateGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0);
+
+            rtcCommitGeometry(hair_geometry);
+            rtcCommitScene(scene);
+
+            return true;
+        }
+
+        unsigned HairStyle::instance(const glm::mat4& transform, const vkhr::Raytracer& raytracer) const {
+            auto instance_geometry = rtcNewGeometry(raytracer.device, RTC_GEOMETRY_TYPE_INSTANCE);
+
+            rtcSetGeometryInstancedScene(instance_geometry, scene);
+            rtcSetGeometryTransform(instance_geometry, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
+                                    glm::value_ptr(transform));
+
+            rtcCommitGeometry(instance_geometry);
+            auto instance_id = rtcAttachGeometry(raytracer.scene, instance_geometry);
+            rtcReleaseGeometry(instance_geometry);
+
+            return instance_id;
         }
 
         glm::vec3 HairStyle::shade(const Ray& surface_intersection,
                                    const LightSource& light_source,
                                    const Camera& projection_camera) {
+            return shade(surface_intersection, light_source, projection_camera, glm::mat3 { 1.0f });
+        }
+
+        glm::vec3 HairStyle::shade(const Ray& surface_intersection,
+                                   const LightSource& light_source,
+                                   const Camera& projection_camera,
+                                   const glm::mat3& tangent_matrix) {
             auto surface_position = surface_intersection.get_intersection_point();
 
-            auto strand_direction = get_tangent(surface_intersection);
+            auto strand_direction = tangent_matrix * glm::vec3 { get_tangent(surface_intersection) };
+            if (glm::dot(strand_direction, strand_direction) > 0.0f) // scaled.
+                strand_direction = glm::normalize(strand_direction);
+
             auto light_normal = glm::normalize(light_source.get_spotlight_origin() - surface_position);
             auto eye_normal = glm::normalize(surface_position - projection_camera.get_position());
 
@@ -65,6 +207,20 @@ namespace vkhr {
         glm::vec4 HairStyle::get_tangent(const Ray& position) const {
             glm::vec4 tangent;
             auto uv = position.get_uv();
+
+            if (curve_type == RoundBezier) {
+                // Which is the derivative of the curve at the hit.
+                rtcInterpolate1(rtcGetGeometry(scene, geometry),
+                                position.get_primitive_id(),
+                                uv.x, uv.y,
+                                RTC_BUFFER_TYPE_VERTEX,
+                                0, nullptr, &tangent.x, nullptr, 3);
+                tangent.w = 0;
+                if (glm::dot(tangent, tangent) > 0.0f)
+                    tangent = glm::normalize(tangent);
+                return tangent;
+            }
+
             rtcInterpolate0(rtcGetGeometry(scene, geometry),
                             position.get_primitive_id(),
                             uv.x, uv.y,
@@ -75,10 +231,116 @@ namespace vkhr {
 
         }
 
+        void HairStyle::prepare_volume() {
+            if (volume != nullptr)
+                return;
+
+            // Same resolution as the rasterizer's, so both have the same shadows.
+            const glm::vec3 resolution { 256, 256, 256 };
+
+            if (pointer->has_volume() && pointer->get_volume().resolution == resolution) {
+                volume = pointer->get_shared_volume();
+            } else {
+                auto strand_volume = pointer->voxelize_segments_sparse(resolution.x, resolution.y, resolution.z,
+                                                                       vkhr::HairStyle::Voxelizer::Exact);
+                strand_volume.normalize();
+                volume = std::make_shared<const vkhr::HairStyle::SparseVolume>(std::move(strand_volume));
+            }
+        }
+
+        bool HairStyle::has_volume() const {
+            return volume != nullptr;
+        }
+
+        float HairStyle::volume_transmittance(const glm::vec3& position,
+                                              const glm::vec3& light_position,
+                                              float raycast_steps) const {
+            const auto voxel_size = volume->bounds.size / volume->resolution;
+
+            const auto root { (position       - volume->bounds.origin) / voxel_size };
+            const auto tip  { (light_position - volume->bounds.origin) / voxel_size };
+
+            float density_integral { 0.0f };
+
+            traverse_voxels(root, tip, glm::ivec3 { 0 }, glm::ivec3 { volume->resolution },
+                            [&](const glm::ivec3& voxel, float t_enter, float t_exit) {
+                density_integral += volume->get_density(voxel.x, voxel.y, voxel.z) / 255.0f * (t_exit - t_enter);
+            });
+
+            // The GLSL takes raycast_steps samples along the whole path to the
+            // light, so that's the expected number of strands that it counts.
+            float strands { density_integral * raycast_steps * VolumeStrandThickness };
+
+            return std::pow(1.0f - hair_opacity, strands);
+        }
+
         unsigned HairStyle::get_geometry() const {
             return geometry;
         }
 
+        HairStyle::CurveType HairStyle::get_curve_type() const {
+            return curve_type;
+        }
+
+        unsigned HairStyle::get_bezier_control_point_count(const vkhr::HairStyle& hair_style) {
+            unsigned control_points { 0 };
+
+            for (const auto& strand : hair_style.get_strand_range()) {
+                unsigned segments { strand.get_vertex_count() - 1 };
+                unsigned curves { (segments + SegmentsPerCurve - 1) / SegmentsPerCurve };
+                control_points += 3 * curves + 1; // shares the end points.
+            }
+
+            return control_points;
+        }
+
+        void HairStyle::create_bezier_curves(const vkhr::HairStyle& hair_style,
+                                             glm::vec4* control_points,
+                                             unsigned* curve_indices) {
+            // Straight from the views, since this runs on every refit too.
+            const auto vertices = hair_style.get_vertices_view();
+            const auto thickness = hair_style.get_thickness_view();
+
+            auto position_radius = [&](unsigned vertex) {
+                float radius { 0.042f }; // same as create_position_thickness_data.
+                if (hair_style.has_thickness())
+                    radius = thickness[vertex];
+                return glm::vec4 { vertices[vertex], radius };
+            };
+
+            unsigned control_point { 0 };
+
+            for (const auto& strand : hair_style.get_strand_range()) {
+                const int last_vertex  { static_cast<int>(strand.get_vertex_count()) - 1 };
+                const int curves { (last_vertex + static_cast<int>(SegmentsPerCurve) - 1) / static_cast<int>(SegmentsPerCurve) };
+
+                auto knot = [&](int k) {
+                    auto vertex = std::min(glm::clamp(k, 0, curves) * static_cast<int>(SegmentsPerCurve), last_vertex);
+                    return position_radius(strand.first_vertex + vertex);
+                };
+
+                for (int k { 0 }; k < curves; ++k) {
+                    const auto p0 = knot(k - 1), p1 = knot(k),
+                               p2 = knot(k + 1), p3 = knot(k + 2);
+
+                    if (curve_indices != nullptr)
+                        *curve_indices++ = control_point;
+
+                    control_points[control_point++] = p1;
+                    control_points[control_point++] = glm::vec4 {
+                        glm::vec3 { p1 } + (glm::vec3 { p2 } - glm::vec3 { p0 }) / 6.0f,
+                        glm::mix(p1.w, p2.w, 1.0f / 3.0f)
+                    };
+                    control_points[control_point++] = glm::vec4 {
+                        glm::vec3 { p2 } - (glm::vec3 { p3 } - glm::vec3 { p1 }) / 6.0f,
+                        glm::mix(p1.w, p2.w, 2.0f / 3.0f)
+                    };
+                }
+
+                control_points[control_point++] = knot(curves);
+            }
+        }
+
         const vkhr::HairStyle* HairStyle::get_pointer() const {
             return pointer;
         }
@@ -110,6 +372,66 @@ namespace vkhr {
         void HairStyle::update_parameters(const vkhr::vulkan::HairStyle& hair_style) {
             hair_diffuse  = hair_style.parameters.hair_color;
             hair_exponent = hair_style.parameters.hair_shininess;
+            hair_opacity  = hair_style.parameters.hair_opacity;
+            update_opacities(*pointer);
+        }
+
+        void HairStyle::update_opacities(const vkhr::HairStyle& hair_style) {
+            const auto transparency_view = hair_style.get_transparency_view();
+
+            std::size_t primitive { 0 };
+
+            // Strands with their own transparency use it instead of the style's.
+            auto write_opacity = [&](unsigned vertex) {
+                float opacity { hair_opacity };
+                if (hair_style.has_transparency())
+                    opacity = transparency_view[vertex];
+                if (primitive >= primitive_opacities.size())
+                    primitive_opacities.push_back(opacity);
+                else primitive_opacities[primitive] = opacity;
+                ++primitive;
+            };
+
+            if (curve_type == RoundBezier) {
+                for (const auto& strand : hair_style.get_strand_range())
+                    for (unsigned segment { 0 }; segment + 1 < strand.get_vertex_count(); segment += SegmentsPerCurve)
+                        write_opacity(strand.first_vertex + segment);
+            } else {
+                for (const auto& segment : hair_style.get_segment_range())
+                    write_opacity(segment.first_vertex);
+            }
+        }
+
+        void HairStyle::occlusion_filter(const RTCFilterFunctionNArguments* arguments) {
+            auto context = reinterpret_cast<const IntersectContext*>(arguments->context);
+
+            if (context->skip_hair) {
+                for (unsigned i { 0 }; i < arguments->N; ++i)
+                    arguments->valid[i] = 0;
+                return; // as if it's not there.
+            }
+
+            if (context->transmittances == nullptr)
+                return; // as opaque.
+
+            auto opacities = static_cast<const float*>(arguments->geometryUserPtr);
+
+            for (unsigned i { 0 }; i < arguments->N; ++i) {
+                if (arguments->valid[i] != -1)
+                    continue;
+
+                auto& shadow = context->transmittances[RTCRayN_id(arguments->ray, arguments->N, i)];
+
+                const auto instance_id  = RTCHitN_instID(arguments->hit, arguments->N, i, 0);
+                const auto primitive_id = RTCHitN_primID(arguments->hit, arguments->N, i);
+
+                if (shadow.add_hit(instance_id, primitive_id))
+                    shadow.transmittance *= 1.0f - opacities[primitive_id];
+
+                // Otherwise it's accepted, which ends the ray as occluded.
+                if (shadow.transmittance > TransmittanceEpsilon)
+                    arguments->valid[i] = 0;
+            }
         }
     }
 }
\ No newline at end of file
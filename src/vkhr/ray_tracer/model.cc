@@ -2,28 +2,115 @@
 
 #include <vkhr/ray_tracer.hh>
 
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <utility>
+
 namespace vkhr {
     namespace embree {
         Model::Model(const vkhr::Model& model, const vkhr::Raytracer& raytracer) {
             load(model, raytracer);
         }
 
+        Model::~Model() noexcept {
+            if (scene != nullptr)
+                rtcReleaseScene(scene);
+        }
+
+        Model::Model(Model&& model) noexcept {
+            swap(*this, model);
+        }
+
+        Model& Model::operator=(Model&& model) noexcept {
+            swap(*this, model);
+            return *this;
+        }
+
+        void swap(Model& lhs, Model& rhs) {
+            using std::swap;
+            swap(lhs.scene,     rhs.scene);
+            swap(lhs.geometry,  rhs.geometry);
+            swap(lhs.diffuse,   rhs.diffuse);
+            swap(lhs.specular,  rhs.specular);
+            swap(lhs.shininess, rhs.shininess);
+        }
+
         void Model::load(const vkhr::Model& model, const vkhr::Raytracer& raytracer) {
+            if (scene != nullptr)
+                rtcReleaseScene(scene);
+
+            scene = rtcNewScene(raytracer.device);
+
             auto model_geometry = rtcNewGeometry(raytracer.device, RTC_GEOMETRY_TYPE_TRIANGLE);
 
-            // Upload geometry here.
+            const auto& vertices = model.get_vertices();
+            const auto& elements = model.get_elements();
 
-            scene = raytracer.scene;
+            // The position is first in each vertex, so the 16-byte loads that
+            // Embree does on the last one still stay inside of the buffer.
+
+            rtcSetSharedGeometryBuffer(model_geometry, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3,
+                                       vertices.data(),
+                                       offsetof(vkhr::Model::Vertex, position),
+                                       sizeof(vertices[0]),
+                                       vertices.size());
+
+            rtcSetSharedGeometryBuffer(model_geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3,
+                                       elements.data(),
+                                       0, 3 * sizeof(elements[0]),
+                                       elements.size() / 3);
 
             rtcCommitGeometry(model_geometry);
-            geometry = rtcAttachGeometry(raytracer.scene, model_geometry);
+            geometry = rtcAttachGeometry(scene, model_geometry);
             rtcReleaseGeometry(model_geometry);
+
+            rtcCommitScene(scene);
+
+            const auto& materials = model.get_materials();
+
+            if (!materials.empty()) {
+                diffuse   = glm::vec3 { materials[0].diffuse[0],  materials[0].diffuse[1],  materials[0].diffuse[2]  };
+                specular  = glm::vec3 { materials[0].specular[0], materials[0].specular[1], materials[0].specular[2] };
+                shininess = std::max(materials[0].shininess, 1.0f);
+            }
+        }
+
+        unsigned Model::instance(const glm::mat4& transform, const vkhr::Raytracer& raytracer) const {
+            auto instance_geometry = rtcNewGeometry(raytracer.device, RTC_GEOMETRY_TYPE_INSTANCE);
+
+            rtcSetGeometryInstancedScene(instance_geometry, scene);
+            rtcSetGeometryTransform(instance_geometry, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
+                                    glm::value_ptr(transform));
+
+            rtcCommitGeometry(instance_geometry);
+            auto instance_id = rtcAttachGeometry(raytracer.scene, instance_geometry);
+            rtcReleaseGeometry(instance_geometry);
+
+            return instance_id;
         }
 
         glm::vec3 Model::shade(const Ray& surface_intersection,
                                const LightSource& light_source,
                                const Camera& projection_camera) {
-            return glm::vec3 { 1.0f };
+            auto surface_position = surface_intersection.get_intersection_point();
+
+            auto surface_normal = glm::normalize(surface_intersection.get_normal());
+            auto light_normal = glm::normalize(light_source.get_spotlight_origin() - surface_position);
+            auto eye_normal = glm::normalize(projection_camera.get_position() - surface_position);
+
+            // Meshes might not be closed, so shade the side that we're seeing.
+            if (glm::dot(surface_normal, eye_normal) < 0.0f)
+                surface_normal = -surface_normal;
+
+            auto shading = blinn_phong(diffuse,
+                                       specular * light_source.get_intensity(),
+                                       shininess, surface_normal,
+                                       light_normal, eye_normal);
+
+            return shading;
         }
 
         unsigned Model::get_geometry() const {
@@ -36,7 +123,19 @@ namespace vkhr {
                                      const glm::vec3& normal,
                                      const glm::vec3& light,
                                      const glm::vec3& eye) {
-            return glm::vec3 { 1.0f };
+            float cosNL = std::max(glm::dot(normal, light), 0.0f);
+
+            if (cosNL == 0.0f)
+                return glm::vec3 { 0.0f };
+
+            auto halfway = glm::normalize(light + eye);
+
+            float cosNH = std::max(glm::dot(normal, halfway), 0.0f);
+
+            glm::vec3 diffuse_colors  = diffuse  * cosNL;
+            glm::vec3 specular_colors = specular * std::pow(cosNH, shininess);
+
+            return diffuse_colors + specular_colors;
         }
     }
 }
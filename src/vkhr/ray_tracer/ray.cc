@@ -1,8 +1,14 @@
 #include <vkhr/ray_tracer/ray.hh>
 
+#include <algorithm>
+
 namespace vkhr {
-    Ray::Ray(const glm::vec3& origin, const glm::vec3& direction, float tnear_plane) {
+    // Streams are strided over Ray, so it can't hold anything but the ray hit.
+    static_assert(sizeof(Ray) == sizeof(RTCRayHit), "Ray must be layout compatible with RTCRayHit");
+
+    Ray::Ray(const glm::vec3& origin, const glm::vec3& direction, float tnear_plane, float tfar_plane) {
         ray_hit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+        ray_hit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
         ray_hit.ray.org_x = origin.x;
         ray_hit.ray.org_y = origin.y;
@@ -13,7 +19,7 @@ namespace vkhr {
         ray_hit.ray.dir_z = direction.z;
 
         ray_hit.ray.tnear = tnear_plane;
-        ray_hit.ray.tfar  = std::numeric_limits<float>::infinity();
+        ray_hit.ray.tfar  = tfar_plane;
     }
 
     RTCRay& Ray::get_ray() {
@@ -55,6 +61,12 @@ namespace vkhr {
                  ray_hit.hit.Ng_z };
     }
 
+    void Ray::set_normal(const glm::vec3& normal) {
+        ray_hit.hit.Ng_x = normal.x;
+        ray_hit.hit.Ng_y = normal.y;
+        ray_hit.hit.Ng_z = normal.z;
+    }
+
     glm::vec4 Ray::get_uniform_normal() const {
         return { ray_hit.hit.Ng_x,
                  ray_hit.hit.Ng_y,
@@ -70,6 +82,27 @@ namespace vkhr {
         return get_uniform_normal();
     }
 
+    bool ShadowTransmittance::add_hit(unsigned instance_id, unsigned primitive_id) {
+        const auto stored_hits = std::min(hit_count, MaximumHits);
+
+        for (unsigned i { 0 }; i < stored_hits; ++i)
+            if (hits[i].instance_id  == instance_id &&
+                hits[i].primitive_id == primitive_id)
+                return false;
+
+        hits[hit_count++ % MaximumHits] = Hit { instance_id, primitive_id };
+
+        return true;
+    }
+
+    void Ray::set_id(unsigned id) {
+        ray_hit.ray.id = id;
+    }
+
+    unsigned Ray::get_id() const {
+        return ray_hit.ray.id;
+    }
+
     unsigned Ray::get_primitive_id() const {
         return ray_hit.hit.primID;
     }
@@ -82,6 +115,14 @@ namespace vkhr {
         return ray_hit.hit.geomID == id;
     }
 
+    unsigned Ray::get_instance_id() const {
+        return ray_hit.hit.instID[0];
+    }
+
+    bool Ray::hit_instance() const {
+        return hit_surface() && ray_hit.hit.instID[0] != RTC_INVALID_GEOMETRY_ID;
+    }
+
     glm::vec3 Ray::get_intersection_point() const {
         return get_origin() + get_direction() * ray_hit.ray.tfar;
     }
@@ -97,16 +138,18 @@ namespace vkhr {
     }
 
     bool Ray::occluded_by(RTCScene& scene, RTCIntersectContext& context, float radius) {
-        rtcIntersect1(scene, &context, &ray_hit);
-        if (hit_surface()) {
-            auto surface_distance = glm::distance(get_intersection_point(), get_origin());
-            if (surface_distance > radius) {
-                return false;
-            } else {
-                return true;
-            }
-        } else {
-            return false;
-        }
+        // Any hit closer than the radius will do, so stop at the first one.
+        ray_hit.ray.tfar = std::min(ray_hit.ray.tfar, radius / glm::length(get_direction()));
+        return occluded_by(scene, context);
+    }
+
+    void Ray::intersect(std::vector<Ray>& rays, RTCScene& scene,  RTCIntersectContext& context) {
+        if (rays.empty()) return;
+        rtcIntersect1M(scene, &context, &rays.front().ray_hit, static_cast<unsigned>(rays.size()), sizeof(Ray));
+    }
+
+    void Ray::occluded_by(std::vector<Ray>& rays, RTCScene& scene, RTCIntersectContext& context) {
+        if (rays.empty()) return;
+        rtcOccluded1M(scene, &context, &rays.front().ray_hit.ray, static_cast<unsigned>(rays.size()), sizeof(Ray));
     }
 }
\ No newline at end of file
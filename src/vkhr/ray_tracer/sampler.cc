@@ -0,0 +1,147 @@
+#include <vkhr/ray_tracer/sampler.hh>
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace vkhr {
+    Sampler::Sampler(std::uint32_t seed, std::uint32_t pixel, std::uint32_t sample)
+                    : pattern { hash(seed ^ hash(pixel ^ hash(sample))) },
+                      pixel_pattern { hash(seed ^ hash(pixel)) },
+                      sample { sample } {  }
+
+    float Sampler::next() {
+        return rand_float(dimension++, pattern);
+    }
+
+    float Sampler::next(float min, float max) {
+        return next() * (max - min) + min;
+    }
+
+    glm::vec2 Sampler::next_2d() {
+        // Every dimension, and every PatternSize samples, get a new pattern.
+        auto p = hash(pixel_pattern ^ hash(dimension++ ^ hash(sample / PatternSize)));
+
+        // Shuffle the order, so that a prefix of it still covers the square.
+        auto s = permute(sample % PatternSize, PatternSize, p * 0x51633e2d);
+
+        return cmj(s, PatternWidth, PatternWidth, p);
+    }
+
+    // "A Low Distortion Map Between Disk and Square" by Shirley and Chiu.
+
+    glm::vec2 Sampler::to_concentric_disk(const glm::vec2& sample) {
+        glm::vec2 offset { 2.0f * sample - 1.0f };
+
+        if (offset.x == 0.0f && offset.y == 0.0f)
+            return glm::vec2 { 0.0f };
+
+        float radius, theta;
+
+        if (std::abs(offset.x) > std::abs(offset.y)) {
+            radius = offset.x;
+            theta  = glm::quarter_pi<float>() * (offset.y / offset.x);
+        } else {
+            radius = offset.y;
+            theta  = glm::half_pi<float>() - glm::quarter_pi<float>() * (offset.x / offset.y);
+        }
+
+        return radius * glm::vec2 { std::cos(theta), std::sin(theta) };
+    }
+
+    glm::vec3 Sampler::to_cosine_hemisphere(const glm::vec2& sample) {
+        auto disk = to_concentric_disk(sample);
+        float z = std::sqrt(std::max(0.0f, 1.0f - disk.x*disk.x - disk.y*disk.y));
+        return glm::vec3 { disk.x, disk.y, z };
+    }
+
+    // "Building an Orthonormal Basis, Revisited" by Duff et al. (2017).
+
+    glm::mat3 Sampler::orthonormal_basis(const glm::vec3& normal) {
+        float sign = std::copysign(1.0f, normal.z);
+
+        const float a = -1.0f / (sign + normal.z);
+        const float b = normal.x * normal.y * a;
+
+        return glm::mat3 {
+            glm::vec3 { 1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x },
+            glm::vec3 { b, sign + normal.y * normal.y * a, -normal.y },
+            normal
+        };
+    }
+
+    // "lowbias32" by Chris Wellons, so that nearby pixels and samples
+    // end up with completely unrelated patterns for the sequence below.
+
+    std::uint32_t Sampler::hash(std::uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352d;
+        x ^= x >> 15;
+        x *= 0x846ca68b;
+        x ^= x >> 16;
+        return x;
+    }
+
+    float Sampler::rand_float(unsigned i, unsigned p) {
+        i ^= p;
+        i ^= i >> 17;
+        i ^= i >> 10;
+        i *= 0xb36534e5;
+        i ^= i >> 12;
+        i ^= i >> 21;
+        i *= 0x93fc4795;
+        i ^= 0xdf6e307f;
+        i ^= i >> 17;
+        i *= 1 | p >> 18;
+        return i * (1.0f / 4294967808.0f);
+    }
+
+    unsigned Sampler::permute(unsigned i, unsigned l, unsigned p) {
+        unsigned w = l - 1;
+
+        w |= w >> 1;
+        w |= w >> 2;
+        w |= w >> 4;
+        w |= w >> 8;
+        w |= w >> 16;
+
+        do {
+            i ^= p;
+            i *= 0xe170893d;
+            i ^= p >> 16;
+            i ^= (i & w) >> 4;
+            i ^= p >> 8;
+            i *= 0x0929eb3f;
+            i ^= p >> 23;
+            i ^= (i & w) >> 1;
+            i *= 1 | p >> 27;
+            i *= 0x6935fa69;
+            i ^= (i & w) >> 11;
+            i *= 0x74dcb303;
+            i ^= (i & w) >> 2;
+            i *= 0x9e501cc3;
+            i ^= (i & w) >> 2;
+            i *= 0xc860a3df;
+            i &= w;
+            i ^= i >> 5;
+        } while (i >= l);
+
+        return (i + p) % l;
+    }
+
+    glm::vec2 Sampler::cmj(int s, int m, int n, int p) {
+        int sx = permute(s % m, m, p * 0xa511e9b3),
+            sy = permute(s / m, n, p * 0x63d83595);
+
+        float jx = rand_float(s, p * 0xa399d265),
+              jy = rand_float(s, p * 0x711ad6a5);
+
+        glm::vec2 r = {
+            (s % m + (sy + jx) / n) / m,
+            (s / m + (sx + jy) / m) / n
+        };
+
+        return r;
+    }
+}
\ No newline at end of file
@@ -225,22 +225,48 @@ namespace vkhr {
         if (hair_styles.find(path) != hair_styles.end())
             return hair_styles[path];
 
-        hair_styles[path] = HairStyle { path };
+        HairCache::Options options {
+            0.042f,                         // strand thickness
+            { 256, 256, 256 },              // strand volume
+            HairStyle::Voxelizer::Exact,    // no skipped voxels
+            true                            // shuffle
+        };
+
+        // Warm start: everything below has been done already.
+        if (hair_cache.load(path, options, hair_styles[path]))
+            return hair_styles[path];
+
+        // Map it, since shuffle() will copy all the fields anyway.
+        hair_styles[path] = HairStyle { path, HairStyle::Loader::Mapped };
 
         // If you get this exception, it most likely means you haven't cloned using Git LFS.
         if (!hair_styles[path]) throw std::runtime_error { "Couldn't find: " + path + "!" };
 
-        hair_styles[path].shuffle();
+        if (options.shuffle)
+            hair_styles[path].shuffle();
+
+        hair_styles[path].generate_strand_offsets();
+        hair_styles[path].generate_position_arrays();
 
         if (!hair_styles[path].has_tangents())
             hair_styles[path].generate_tangents();
         if (!hair_styles[path].has_thickness())
-            hair_styles[path].generate_thickness(0.042f);
-        if (!hair_styles[path].has_indices())
-            hair_styles[path].generate_indices();
+            hair_styles[path].generate_thickness(options.strand_thickness);
         if (!hair_styles[path].has_bounding_box())
             hair_styles[path].generate_bounding_box();
 
+        hair_styles[path].clear_position_arrays();
+
+        auto strand_volume = hair_styles[path].voxelize_segments_sparse(options.volume_resolution.x,
+                                                                        options.volume_resolution.y,
+                                                                        options.volume_resolution.z,
+                                                                        options.voxelizer);
+        strand_volume.normalize();
+
+        hair_styles[path].set_volume(std::move(strand_volume));
+
+        hair_cache.save(path, options, hair_styles[path]);
+
         return hair_styles[path];
     }
 
@@ -333,6 +359,10 @@ namespace vkhr {
         return scene_path;
     }
 
+    HairCache& SceneGraph::get_hair_cache() {
+        return hair_cache;
+    }
+
     const std::vector<HairStyle*>& SceneGraph::Node::get_hair_styles() const {
         return hair_styles;
     }
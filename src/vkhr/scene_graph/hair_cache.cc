@@ -0,0 +1,240 @@
+#include <vkhr/scene_graph/hair_cache.hh>
+
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
+
+namespace vkhr {
+    HairCache::HairCache(const std::string& cache_directory)
+                        : cache_directory { cache_directory } {  }
+
+    bool HairCache::load(const std::string& style_path, const Options& options, HairStyle& hair_style) const {
+        if (!enabled) return false;
+
+        auto key = get_key(style_path, options);
+
+        if (key == 0) return false;
+
+        auto entry_path = get_entry_path(key);
+
+        HairStyle::SparseVolume volume;
+
+        if (!load_volume(entry_path + ".vox", key, volume))
+            return false;
+
+        HairStyle baked_style { entry_path + ".hair", HairStyle::Loader::Parallel };
+
+        if (!baked_style || !baked_style.has_tangents()  ||
+                            !baked_style.has_thickness() ||
+                            !baked_style.has_bounding_box())
+            return false;
+
+        // Same as the cold path in SceneGraph::add_style, which builds them.
+        baked_style.generate_strand_offsets();
+
+        baked_style.set_volume(std::move(volume));
+
+        hair_style = std::move(baked_style);
+
+        return true;
+    }
+
+    bool HairCache::save(const std::string& style_path, const Options& options, const HairStyle& hair_style) const {
+        if (!enabled || !hair_style.has_volume()) return false;
+
+        auto key = get_key(style_path, options);
+
+        if (key == 0) return false;
+
+        std::error_code error;
+        std::filesystem::create_directories(cache_directory, error);
+
+        if (error) return false;
+
+        auto entry_path = get_entry_path(key);
+
+        // Write to temporaries first so a crash won't leave a half-baked entry.
+
+        if (!hair_style.save(entry_path + ".hair.tmp"))
+            return false;
+
+        if (!save_volume(entry_path + ".vox.tmp", key, hair_style.get_volume())) {
+            std::filesystem::remove(entry_path + ".hair.tmp", error);
+            return false;
+        }
+
+        std::filesystem::rename(entry_path + ".hair.tmp", entry_path + ".hair", error);
+        if (error) return false;
+        std::filesystem::rename(entry_path + ".vox.tmp", entry_path + ".vox", error);
+        if (error) return false;
+
+        return true;
+    }
+
+    std::uint64_t HairCache::get_key(const std::string& style_path, const Options& options) const {
+        std::error_code error;
+
+        auto canonical_path = std::filesystem::canonical(style_path, error).string();
+        if (error) return 0;
+        auto modified_time = std::filesystem::last_write_time(style_path, error).time_since_epoch().count();
+        if (error) return 0;
+        auto file_size = static_cast<std::uint64_t>(std::filesystem::file_size(style_path, error));
+        if (error) return 0;
+
+        std::uint64_t hash { 0xcbf29ce484222325 };
+
+        hash = fnv1a(&Version, sizeof(Version), hash);
+        hash = fnv1a(canonical_path.data(), canonical_path.size(), hash);
+        hash = fnv1a(&modified_time, sizeof(modified_time), hash);
+        hash = fnv1a(&file_size, sizeof(file_size), hash);
+        hash = fnv1a(&options.strand_thickness, sizeof(options.strand_thickness), hash);
+        hash = fnv1a(&options.volume_resolution, sizeof(options.volume_resolution), hash);
+        hash = fnv1a(&options.voxelizer, sizeof(options.voxelizer), hash);
+        hash = fnv1a(&options.shuffle, sizeof(options.shuffle), hash);
+
+        return hash != 0 ? hash : 1;
+    }
+
+    void HairCache::set_enabled(bool enabled) {
+        this->enabled = enabled;
+    }
+
+    bool HairCache::is_enabled() const {
+        return enabled;
+    }
+
+    void HairCache::set_cache_directory(const std::string& cache_directory) {
+        this->cache_directory = cache_directory;
+    }
+
+    const std::string& HairCache::get_cache_directory() const {
+        return cache_directory;
+    }
+
+    std::string HairCache::get_entry_path(std::uint64_t key) const {
+        char key_string[17];
+        std::snprintf(key_string, sizeof(key_string), "%016llx",
+                      static_cast<unsigned long long>(key));
+        return cache_directory + key_string;
+    }
+
+    bool HairCache::load_volume(const std::string& file_path, std::uint64_t key, HairStyle::SparseVolume& volume) const {
+        std::ifstream file { file_path, std::ios::binary };
+
+        if (!file) return false;
+
+        VolumeHeader header;
+
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+            return false;
+
+        if (header.signature[0] != 'V' || header.signature[1] != 'O' ||
+            header.signature[2] != 'X' || header.signature[3] != 'L')
+            return false;
+
+        if (header.version != Version || header.key != key)
+            return false;
+
+        volume.resolution = glm::vec3 {
+            header.resolution[0],
+            header.resolution[1],
+            header.resolution[2]
+        };
+
+        glm::vec3 origin { header.bounds_origin[0], header.bounds_origin[1], header.bounds_origin[2] };
+        glm::vec3 size   { header.bounds_size[0],   header.bounds_size[1],   header.bounds_size[2]   };
+
+        volume.bounds = AABB {
+            origin,
+            glm::length(size),
+            size,
+            size.x * size.y * size.z
+        };
+
+        volume.brick_resolution = glm::ivec3 {
+            header.brick_resolution[0],
+            header.brick_resolution[1],
+            header.brick_resolution[2]
+        };
+
+        // Don't allocate anything that doesn't match up with the resolution.
+        for (int i { 0 }; i < 3; ++i) {
+            const auto brick_size = HairStyle::SparseVolume::BrickSize;
+            if (header.resolution[i] <= 0 || header.brick_resolution[i] !=
+                header.resolution[i] / brick_size + (header.resolution[i] % brick_size != 0))
+                return false;
+        }
+
+        volume.brick_index.resize(static_cast<std::size_t>(header.brick_resolution[0]) *
+                                  static_cast<std::size_t>(header.brick_resolution[1]) *
+                                  static_cast<std::size_t>(header.brick_resolution[2]));
+
+        if (header.brick_count > volume.brick_index.size())
+            return false;
+
+        volume.bricks.resize(header.brick_count);
+
+        if (!file.read(reinterpret_cast<char*>(volume.brick_index.data()),
+                       volume.brick_index.size() * sizeof(volume.brick_index[0])))
+            return false;
+
+        if (!file.read(reinterpret_cast<char*>(volume.bricks.data()),
+                       volume.bricks.size() * sizeof(volume.bricks[0])))
+            return false;
+
+        // Don't trust the index if the file got truncated or corrupted.
+        for (const auto brick : volume.brick_index)
+            if (brick != HairStyle::SparseVolume::EmptyBrick && brick >= volume.bricks.size())
+                return false;
+
+        return true;
+    }
+
+    bool HairCache::save_volume(const std::string& file_path, std::uint64_t key, const HairStyle::SparseVolume& volume) const {
+        std::ofstream file { file_path, std::ios::binary };
+
+        if (!file) return false;
+
+        VolumeHeader header {
+            { 'V', 'O', 'X', 'L' },
+            Version,
+            key,
+            {
+                static_cast<std::int32_t>(volume.resolution.x),
+                static_cast<std::int32_t>(volume.resolution.y),
+                static_cast<std::int32_t>(volume.resolution.z)
+            },
+            { volume.bounds.origin.x, volume.bounds.origin.y, volume.bounds.origin.z },
+            { volume.bounds.size.x,   volume.bounds.size.y,   volume.bounds.size.z   },
+            {
+                volume.brick_resolution.x,
+                volume.brick_resolution.y,
+                volume.brick_resolution.z
+            },
+            static_cast<std::uint32_t>(volume.bricks.size())
+        };
+
+        if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)))
+            return false;
+
+        if (!file.write(reinterpret_cast<const char*>(volume.brick_index.data()),
+                        volume.brick_index.size() * sizeof(volume.brick_index[0])))
+            return false;
+
+        if (!file.write(reinterpret_cast<const char*>(volume.bricks.data()),
+                        volume.bricks.size() * sizeof(volume.bricks[0])))
+            return false;
+
+        return true;
+    }
+
+    std::uint64_t HairCache::fnv1a(const void* data, std::size_t size, std::uint64_t hash) {
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i { 0 }; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3;
+        }
+
+        return hash;
+    }
+}
@@ -1,16 +1,28 @@
 #include <vkhr/scene_graph/hair_style.hh>
 
+#include <vkhr/scene_graph/voxel_traversal.hh>
+
+#include <emmintrin.h>
+
 #include <random>
 #include <cstring>
+#include <cassert>
 #include <algorithm>
 #include <fstream>
 #include <numeric>
+#include <cmath>
+#include <limits>
 
 namespace vkhr {
-    HairStyle::HairStyle(const std::string& file_path) {
+    HairStyle::HairStyle(const std::string& file_path, Loader loader) {
         std::random_device random;
         seed = random();
-        load(file_path);
+        if (loader == Loader::Mapped)
+            map(file_path);
+        else if (loader == Loader::Parallel)
+            load_parallel(file_path);
+        else
+            load(file_path);
     }
 
     HairStyle::operator bool() const {
@@ -22,6 +34,9 @@ namespace vkhr {
     }
 
     bool HairStyle::load(const std::string& file_path) {
+        release_mapping(); // in case we mapped before.
+        clear_strand_data();
+
         std::ifstream file { file_path, std::ios::binary };
 
         if (!file) return set_error_state(Error::OpeningFile);
@@ -31,6 +46,14 @@ namespace vkhr {
 
         if (!valid_signature()) return set_error_state(Error::InvalidSignature);
 
+        if (file_header.field.compression > CompressionVersion)
+            return set_error_state(Error::UnsupportedCompression);
+
+        quantization_error = QuantizationError {  };
+
+        if (file_header.field.compression && !read_compression_header(file))
+            return set_error_state(Error::ReadingFileHeader);
+
         if (!read_segments(file)) return set_error_state(Error::ReadingSegments);
         if (!read_vertices(file)) return set_error_state(Error::ReadingVertices);
         if (!read_thickness(file)) return set_error_state(Error::ReadingThickness);
@@ -44,34 +67,194 @@ namespace vkhr {
         return set_error_state(Error::None);
     }
 
-    bool HairStyle::save(const std::string& file_path) const {
+    bool HairStyle::map(const std::string& file_path) {
+        auto file = std::make_shared<MappedFile>(file_path);
+
+        if (!*file) return set_error_state(Error::OpeningFile);
+
+        if (file->get_size() < sizeof(FileHeader))
+            return set_error_state(Error::ReadingFileHeader);
+
+        std::memcpy(&file_header, file->get_data(), sizeof(FileHeader));
+
+        if (!valid_signature()) return set_error_state(Error::InvalidSignature);
+
+        // Quantized fields need to be decoded anyway, so nothing to map.
+        if (file_header.field.compression) return load(file_path);
+
+        release_mapping();
+        clear_strand_data();
+
+        mapped_file = std::move(file);
+
+        // Fields are tightly packed after the header in the same order as
+        // load(), so we can find the offsets from the header counts alone.
+
+        std::size_t offset { sizeof(FileHeader) };
+
+        if (!map_field(offset, file_header.field.has_segments, file_header.strand_count, segments, mapped.segments))
+            return set_error_state(Error::ReadingSegments);
+        if (!map_field(offset, file_header.field.has_vertices, file_header.vertex_count, vertices, mapped.vertices))
+            return set_error_state(Error::ReadingVertices);
+        if (!map_field(offset, file_header.field.has_thickness, file_header.vertex_count, thickness, mapped.thickness))
+            return set_error_state(Error::ReadingThickness);
+        if (!map_field(offset, file_header.field.has_transparency, file_header.vertex_count, transparency, mapped.transparency))
+            return set_error_state(Error::ReadingTransparency);
+        if (!map_field(offset, file_header.field.has_color, file_header.vertex_count, color, mapped.color))
+            return set_error_state(Error::ReadingColor);
+        if (!map_field(offset, file_header.field.has_tangents, file_header.vertex_count, tangents, mapped.tangents))
+            return set_error_state(Error::ReadingTangents);
+        if (!map_field(offset, file_header.field.has_indices, get_segment_count() * 2, indices, mapped.indices))
+            return set_error_state(Error::ReadingIndices);
+
+        if (!format_is_valid()) return set_error_state(Error::InvalidFormat);
+
+        return set_error_state(Error::None);
+    }
+
+    bool HairStyle::load_parallel(const std::string& file_path, const ProgressCallback& progress, std::size_t chunk_size) {
+        release_mapping(); // in case we mapped before.
+        clear_strand_data();
+
+        RandomAccessFile file { file_path };
+
+        if (!file) return set_error_state(Error::OpeningFile);
+
+        if (!file.read(&file_header, sizeof(FileHeader), 0))
+            return set_error_state(Error::ReadingFileHeader);
+
+        if (!valid_signature()) return set_error_state(Error::InvalidSignature);
+
+        // The quantized fields are small and are decoded strand by strand.
+        if (file_header.field.compression) return load(file_path);
+
+        std::vector<FieldChunk> chunks;
+
+        std::size_t offset { sizeof(FileHeader) };
+        std::size_t file_size { file.get_size() };
+
+        if (chunk_size == 0) chunk_size = file_size;
+
+        // Allocates each field up-front and splits it into chunks, the indices need
+        // the segments and vertices to be resized first to find the segment count.
+
+        if (!plan_field_read(offset, file_header.field.has_segments, file_header.strand_count, segments, chunk_size, file_size, chunks, Error::ReadingSegments))
+            return set_error_state(Error::ReadingSegments);
+        if (!plan_field_read(offset, file_header.field.has_vertices, file_header.vertex_count, vertices, chunk_size, file_size, chunks, Error::ReadingVertices))
+            return set_error_state(Error::ReadingVertices);
+        if (!plan_field_read(offset, file_header.field.has_thickness, file_header.vertex_count, thickness, chunk_size, file_size, chunks, Error::ReadingThickness))
+            return set_error_state(Error::ReadingThickness);
+        if (!plan_field_read(offset, file_header.field.has_transparency, file_header.vertex_count, transparency, chunk_size, file_size, chunks, Error::ReadingTransparency))
+            return set_error_state(Error::ReadingTransparency);
+        if (!plan_field_read(offset, file_header.field.has_color, file_header.vertex_count, color, chunk_size, file_size, chunks, Error::ReadingColor))
+            return set_error_state(Error::ReadingColor);
+        if (!plan_field_read(offset, file_header.field.has_tangents, file_header.vertex_count, tangents, chunk_size, file_size, chunks, Error::ReadingTangents))
+            return set_error_state(Error::ReadingTangents);
+        if (!plan_field_read(offset, file_header.field.has_indices, get_segment_count() * 2, indices, chunk_size, file_size, chunks, Error::ReadingIndices))
+            return set_error_state(Error::ReadingIndices);
+
+        std::size_t bytes_read { sizeof(FileHeader) };
+        std::size_t failed_chunk { chunks.size() };
+
+        if (progress) progress(bytes_read, offset);
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < static_cast<int>(chunks.size()); ++i) {
+            const auto& chunk = chunks[i];
+
+            bool chunk_read = file.read(chunk.data, chunk.size, chunk.offset);
+
+            #pragma omp critical (hair_style_load_parallel)
+            {
+                if (!chunk_read) {
+                    // Report the first failing field, like load().
+                    failed_chunk = std::min(failed_chunk,
+                                            static_cast<std::size_t>(i));
+                } else {
+                    bytes_read += chunk.size;
+                    if (progress) progress(bytes_read, offset);
+                }
+            }
+        }
+
+        if (failed_chunk != chunks.size())
+            return set_error_state(chunks[failed_chunk].error);
+
+        if (!format_is_valid()) return set_error_state(Error::InvalidFormat);
+
+        return set_error_state(Error::None);
+    }
+
+    void HairStyle::materialize() {
+        materialize_field(segments, mapped.segments);
+        materialize_field(vertices, mapped.vertices);
+        materialize_field(thickness, mapped.thickness);
+        materialize_field(transparency, mapped.transparency);
+        materialize_field(color, mapped.color);
+        materialize_field(tangents, mapped.tangents);
+        materialize_field(indices, mapped.indices);
+        mapped_file.reset();
+    }
+
+    bool HairStyle::is_mapped() const {
+        return mapped_file != nullptr;
+    }
+
+    void HairStyle::release_mapping() {
+        mapped = MappedFields {  };
+        mapped_file.reset();
+    }
+
+    void HairStyle::clear_strand_data() {
+        strand_offsets.clear();
+        clear_position_arrays();
+    }
+
+    bool HairStyle::save(const std::string& file_path, Compression compression) const {
         complete_header(); // Fill in remaining header fields.
 
         if (!format_is_valid()) return set_error_state(Error::InvalidFormat);
 
+        quantization_error = QuantizationError {  };
+
+        // The compression only applies to the file, so we don't touch ours.
+        FileHeader header { file_header };
+        CompressionHeader compression_parameters {  };
+
+        if (compression == Compression::Quantized) {
+            header.field.compression = CompressionVersion;
+            prepare_compression_header(header, compression_parameters);
+        }
+
         std::ofstream file { file_path, std::ios::binary };
 
         if (!file) return set_error_state(Error::OpeningFile);
 
-        if (!file.write(reinterpret_cast<char*>(&file_header), sizeof(FileHeader)))
+        if (!file.write(reinterpret_cast<char*>(&header), sizeof(FileHeader)))
+            return set_error_state(Error::WritingFileHeader);
+        if (header.field.compression && !write_compression_header(file, compression_parameters))
             return set_error_state(Error::WritingFileHeader);
 
-        if (!write_segments(file)) return set_error_state(Error::WritingSegments);
-        if (!write_vertices(file)) return set_error_state(Error::WritingVertices);
-        if (!write_thickness(file)) return set_error_state(Error::WritingThickness);
-        if (!write_transparancy(file)) return set_error_state(Error::WritingTransparency);
-        if (!write_color(file)) return set_error_state(Error::WritingColor);
-        if (!write_tangents(file)) return set_error_state(Error::WritingTangents);
-        if (!write_indices(file)) return set_error_state(Error::WritingIndices);
+        if (!write_segments(file, header)) return set_error_state(Error::WritingSegments);
+        if (!write_vertices(file, header, compression_parameters)) return set_error_state(Error::WritingVertices);
+        if (!write_thickness(file, header, compression_parameters)) return set_error_state(Error::WritingThickness);
+        if (!write_transparancy(file, header, compression_parameters)) return set_error_state(Error::WritingTransparency);
+        if (!write_color(file, header)) return set_error_state(Error::WritingColor);
+        if (!write_tangents(file, header)) return set_error_state(Error::WritingTangents);
+        if (!write_indices(file, header, compression_parameters)) return set_error_state(Error::WritingIndices);
 
         // Signature is already set, so we don't need to check for validity.
 
         return set_error_state(Error::None);
     }
 
+    HairStyle::QuantizationError HairStyle::get_quantization_error() const {
+        return quantization_error;
+    }
+
     unsigned HairStyle::get_strand_count() const {
-        if (segments.size() != 0) {
-            return static_cast<unsigned>(segments.size());
+        if (has_segments()) {
+            return static_cast<unsigned>(get_segments_view().size());
         } else {
             // Use the manually defined one.
             return file_header.strand_count;
@@ -87,16 +270,16 @@ namespace vkhr {
     }
 
     unsigned HairStyle::get_vertex_count() const {
-        return static_cast<unsigned>(vertices.size());
+        return static_cast<unsigned>(get_vertices_view().size());
     }
 
-    bool HairStyle::has_segments() const { return segments.size(); }
-    bool HairStyle::has_vertices() const { return vertices.size(); }
-    bool HairStyle::has_thickness() const { return thickness.size(); }
-    bool HairStyle::has_transparency() const { return transparency.size(); }
-    bool HairStyle::has_color() const { return color.size(); }
-    bool HairStyle::has_tangents() const { return tangents.size(); }
-    bool HairStyle::has_indices() const { return indices.size(); }
+    bool HairStyle::has_segments() const { return get_segments_view().size(); }
+    bool HairStyle::has_vertices() const { return get_vertices_view().size(); }
+    bool HairStyle::has_thickness() const { return get_thickness_view().size(); }
+    bool HairStyle::has_transparency() const { return get_transparency_view().size(); }
+    bool HairStyle::has_color() const { return get_color_view().size(); }
+    bool HairStyle::has_tangents() const { return get_tangents_view().size(); }
+    bool HairStyle::has_indices() const { return get_indices_view().size(); }
 
     // Pre-generated AABB for the hair styles.
     bool HairStyle::has_bounding_box() const {
@@ -153,70 +336,179 @@ namespace vkhr {
     }
 
     void HairStyle::generate_thickness(float radius) {
-        thickness.clear();
-        thickness.reserve(get_vertex_count());
-
-        for (std::size_t strand { 0 }; strand < get_strand_count(); ++strand) {
-            unsigned segment_count { get_default_segment_count() };
-
-            if (has_segments()) segment_count = segments[strand];
+        mapped.thickness = ArrayView<float> {  };
 
-            for (std::size_t segment { 0 }; segment < segment_count; ++segment)
-                thickness.push_back(radius);
+        thickness.assign(get_vertex_count(), radius);
 
-            thickness.push_back(0);
-        }
+        for (const auto& strand : get_strand_range())
+            thickness[strand.get_last_vertex()] = 0;
     }
 
     void HairStyle::generate_tangents() {
+        const auto vertices = get_vertices_view();
+
+        mapped.tangents = ArrayView<glm::vec3> {  };
+
         tangents.clear();
-        tangents.reserve(get_vertex_count());
 
-        std::size_t vertex { 0 };
+        if (has_position_arrays()) {
+            const auto& x = position_arrays.x;
+            const auto& y = position_arrays.y;
+            const auto& z = position_arrays.z;
 
-        for (std::size_t strand { 0 }; strand < get_strand_count(); ++strand) {
-            unsigned segment_count { get_default_segment_count() };
+            tangents.resize(x.size());
 
-            if (has_segments()) segment_count = segments[strand];
+            const int last_vertex = static_cast<int>(x.size()) - 1;
+
+            // Also finds "tangents" between strands, but they're fixed below.
+            for (int i = 0; i < last_vertex; ++i) {
+                tangents[i] = glm::normalize(glm::vec3 { x[i + 1] - x[i],
+                                                         y[i + 1] - y[i],
+                                                         z[i + 1] - z[i] });
+            }
+
+            // Tips don't have a next vertex, so we use the previous tangent.
+            for (const auto& strand : get_strand_range()) {
+                const auto tip = strand.get_last_vertex();
+                if (tip != 0) tangents[tip] = tangents[tip - 1];
+            }
+
+            return;
+        }
+
+        tangents.reserve(get_vertex_count());
 
-            for (std::size_t segment { 0 }; segment < segment_count; ++segment) {
-                const auto& current_vertex { vertices[vertex + 0] };
-                const auto& next_vertex    { vertices[vertex + 1] };
+        for (const auto& strand : get_strand_range()) {
+            for (std::size_t segment { 0 }; segment < strand.segment_count; ++segment) {
+                const auto& current_vertex { vertices[strand.first_vertex + segment + 0] };
+                const auto& next_vertex    { vertices[strand.first_vertex + segment + 1] };
                 const auto tangent { next_vertex - current_vertex };
 
                 tangents.push_back(glm::normalize(tangent));
-                ++vertex;
             }
 
             tangents.push_back(tangents.back()); // Special:
-            ++vertex; // must derive tangents from previous.
+            // must derive tangents from previous.
         }
     }
 
     void HairStyle::generate_indices() {
-        indices.clear();
-        indices.reserve(get_segment_count() * 2);
+        mapped.indices = ArrayView<unsigned> {  };
+        indices.clear(); // or we'd get the old ones.
+        indices = create_index_data();
+    }
 
-        std::size_t vertex { 0 };
-        for (std::size_t strand { 0 }; strand < get_strand_count(); ++strand) {
-            unsigned segment_count { get_default_segment_count() };
+    StrandRange HairStyle::get_strand_range() const {
+        return StrandRange {
+            get_segments_view(),
+            get_default_segment_count(),
+            get_strand_count()
+        };
+    }
 
-            if (has_segments()) segment_count = this->segments[strand];
+    SegmentRange HairStyle::get_segment_range() const {
+        return SegmentRange {
+            get_strand_range(),
+            get_segment_count()
+        };
+    }
 
-            for (std::size_t segment { 0 }; segment < segment_count; ++segment) {
-                indices.push_back(static_cast<unsigned>(vertex++));
-                indices.push_back(static_cast<unsigned>(vertex));
-            }
+    std::vector<unsigned> HairStyle::create_index_data() const {
+        if (has_indices()) return get_indices_view().to_vector();
+
+        std::vector<unsigned> index_data;
+        index_data.reserve(get_segment_count() * 2);
+
+        for (const auto& segment : get_segment_range()) {
+            index_data.push_back(segment.first_vertex);
+            index_data.push_back(segment.second_vertex);
+        }
+
+        return index_data;
+    }
+
+    void HairStyle::generate_strand_offsets() {
+        strand_offsets.clear();
+        strand_offsets.reserve(get_strand_count() + 1);
+
+        for (const auto& strand : get_strand_range())
+            strand_offsets.push_back(strand.first_vertex);
+
+        strand_offsets.push_back(get_vertex_count());
+    }
+
+    bool HairStyle::has_strand_offsets() const {
+        return !strand_offsets.empty();
+    }
+
+    ArrayView<unsigned> HairStyle::get_strand_offsets() const {
+        return ArrayView<unsigned> { strand_offsets };
+    }
+
+    Strand HairStyle::get_strand(std::size_t strand) const {
+        if (has_strand_offsets()) {
+            return Strand {
+                static_cast<unsigned>(strand),
+                strand_offsets[strand],
+                strand_offsets[strand + 1] - strand_offsets[strand] - 1
+            };
+        }
+
+        auto strand_iterator = get_strand_range().begin();
+        std::advance(strand_iterator, strand);
+        return *strand_iterator; // O(n) without offsets.
+    }
+
+    void HairStyle::generate_position_arrays() {
+        const auto vertices = get_vertices_view();
+
+        position_arrays.x.resize(vertices.size());
+        position_arrays.y.resize(vertices.size());
+        position_arrays.z.resize(vertices.size());
 
-            ++vertex; // Skips the last one.
+        for (std::size_t i { 0 }; i < vertices.size(); ++i) {
+            position_arrays.x[i] = vertices[i].x;
+            position_arrays.y[i] = vertices[i].y;
+            position_arrays.z[i] = vertices[i].z;
         }
     }
 
+    bool HairStyle::has_position_arrays() const {
+        return !position_arrays.x.empty();
+    }
+
+    const HairStyle::PositionArrays& HairStyle::get_position_arrays() const {
+        return position_arrays;
+    }
+
+    void HairStyle::clear_position_arrays() {
+        position_arrays = PositionArrays {  };
+    }
+
     void HairStyle::generate_bounding_box() {
         glm::vec3 min_aabb { 0.0f, 0.0f, 0.0f },
                   max_aabb { 0.0f, 0.0f, 0.0f };
 
-        for (const auto& position : vertices) {
+        if (has_position_arrays()) {
+            const auto& x = position_arrays.x;
+            const auto& y = position_arrays.y;
+            const auto& z = position_arrays.z;
+
+            float min_x { 0.0f }, min_y { 0.0f }, min_z { 0.0f },
+                  max_x { 0.0f }, max_y { 0.0f }, max_z { 0.0f };
+
+            for (int i = 0; i < static_cast<int>(x.size()); ++i) {
+                min_x = std::min(x[i], min_x);
+                min_y = std::min(y[i], min_y);
+                min_z = std::min(z[i], min_z);
+                max_x = std::max(x[i], max_x);
+                max_y = std::max(y[i], max_y);
+                max_z = std::max(z[i], max_z);
+            }
+
+            min_aabb = glm::vec3 { min_x, min_y, min_z };
+            max_aabb = glm::vec3 { max_x, max_y, max_z };
+        } else for (const auto& position : get_vertices_view()) {
             min_aabb.x = glm::min(position.x, min_aabb.x);
             min_aabb.y = glm::min(position.y, min_aabb.y);
             min_aabb.z = glm::min(position.z, min_aabb.z);
@@ -234,16 +526,20 @@ namespace vkhr {
     }
 
     AABB HairStyle::get_bounding_box() const {
+        return get_bounding_box(file_header);
+    }
+
+    AABB HairStyle::get_bounding_box(const FileHeader& header) {
         glm::vec3 origin {
-            file_header.bounding_box_min[0],
-            file_header.bounding_box_min[1],
-            file_header.bounding_box_min[2]
+            header.bounding_box_min[0],
+            header.bounding_box_min[1],
+            header.bounding_box_min[2]
         };
 
         glm::vec3 size {
-             file_header.bounding_box_max[0] - file_header.bounding_box_min[0],
-             file_header.bounding_box_max[1] - file_header.bounding_box_min[1],
-             file_header.bounding_box_max[2] - file_header.bounding_box_min[2]
+             header.bounding_box_max[0] - header.bounding_box_min[0],
+             header.bounding_box_max[1] - header.bounding_box_min[1],
+             header.bounding_box_max[2] - header.bounding_box_min[2]
         };
 
         return AABB {
@@ -269,11 +565,43 @@ namespace vkhr {
 
         std::vector<glm::vec3> precise_tangents(width * height * depth);
 
+        const auto vertices = get_vertices_view();
+        const auto tangents = get_tangents_view();
+
+        std::vector<unsigned> voxel_indices;
+
+        // Find all voxel indices up-front over the arrays (vectorizable),
+        // since it's the scatter below that can't be done all at once.
+        if (has_position_arrays()) {
+            const auto& x = position_arrays.x;
+            const auto& y = position_arrays.y;
+            const auto& z = position_arrays.z;
+
+            voxel_indices.resize(x.size());
+
+            const glm::vec3 origin { volume.bounds.origin };
+            const glm::vec3 last_voxel { volume.resolution - 1.0000f };
+
+            for (int i = 0; i < static_cast<int>(x.size()); ++i) {
+                float voxel_x = std::min(std::floor((x[i] - origin.x) / voxel_size.x), last_voxel.x);
+                float voxel_y = std::min(std::floor((y[i] - origin.y) / voxel_size.y), last_voxel.y);
+                float voxel_z = std::min(std::floor((z[i] - origin.z) / voxel_size.z), last_voxel.z);
+                voxel_indices[i] = static_cast<unsigned>(voxel_x + voxel_y*width + voxel_z*width*height);
+            }
+        }
+
         for (unsigned int i { 0 }; i < get_vertex_count(); ++i) {
-            auto& vertex = vertices[i];
-            glm::vec3 voxel { (vertex - volume.bounds.origin) / voxel_size };
-            voxel = glm::min(glm::floor(voxel), volume.resolution - 1.0000f);
-            std::size_t pos = voxel.x + voxel.y*width + voxel.z*width*height;
+            std::size_t pos;
+
+            if (!voxel_indices.empty()) {
+                pos = voxel_indices[i];
+            } else {
+                auto& vertex = vertices[i];
+                glm::vec3 voxel { (vertex - volume.bounds.origin) / voxel_size };
+                voxel = glm::min(glm::floor(voxel), volume.resolution - 1.0000f);
+                pos = voxel.x + voxel.y*width + voxel.z*width*height;
+            }
+
             if (volume.densities[pos] != 255) {
                 precise_tangents[pos] += tangents[i];
                 volume.densities[pos] += 1;
@@ -293,8 +621,16 @@ namespace vkhr {
         return volume;
     }
 
-    HairStyle::Volume HairStyle::voxelize_segments(std::size_t width, std::size_t height, std::size_t depth) const {
-        Volume volume {
+    HairStyle::Volume HairStyle::voxelize_segments(std::size_t width, std::size_t height, std::size_t depth, Voxelizer voxelizer) const {
+        auto volume = voxelize_segments_sparse(width, height, depth, voxelizer);
+        if (voxelizer == Voxelizer::Exact) volume.normalize();
+        return volume.to_dense();
+    }
+
+    HairStyle::SparseVolume HairStyle::voxelize_segments_sparse(std::size_t width, std::size_t height, std::size_t depth, Voxelizer voxelizer) const {
+        constexpr int BrickSize { SparseVolume::BrickSize };
+
+        SparseVolume volume {
             {
                 width,
                 height,
@@ -303,44 +639,420 @@ namespace vkhr {
             get_bounding_box()
         };
 
-        volume.densities.resize(width * height * depth, 0); // ~ 16MiBs.
+        volume.brick_resolution = glm::ivec3 {
+            (static_cast<int>(width)  + BrickSize - 1) / BrickSize,
+            (static_cast<int>(height) + BrickSize - 1) / BrickSize,
+            (static_cast<int>(depth)  + BrickSize - 1) / BrickSize
+        };
+
         glm::vec3 voxel_size { volume.bounds.size / volume.resolution };
 
-        std::vector<glm::vec3> precise_tangents(width * height * depth);
+        const auto vertices = get_vertices_view();
+        const auto tangents = get_tangents_view();
+
+        // Every thread owns a slab of bricks in the volume, and walks only
+        // the segments that touch it, in the same order as a serial pass. So
+        // each voxel sees its tangent sums and 255 clamps in the same order,
+        // and the result is bit-identical for any number of threads we use.
+
+        const int slab_count { volume.brick_resolution.z };
+
+        const auto strands = get_strand_range();
+
+        // Batches of strands are binned in parallel, and every batch keeps a
+        // list of segments (i.e. their first vertex) for each slab it hits.
+
+        const std::size_t batch_size { 4096 };
+
+        std::vector<StrandIterator> batches;
+        batches.reserve(strands.size() / batch_size + 1);
+
+        std::size_t strand_index { 0 };
+        for (auto strand = strands.begin(); strand != strands.end(); ++strand)
+            if (strand_index++ % batch_size == 0) batches.push_back(strand);
+
+        std::vector<std::vector<std::vector<unsigned>>> slab_segments(batches.size());
+
+        const float last_layer { volume.resolution.z - 1.0f };
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int batch = 0; batch < static_cast<int>(batches.size()); ++batch) {
+            auto& batch_segments = slab_segments[batch];
+            batch_segments.resize(slab_count);
+
+            auto strand = batches[batch];
+            for (std::size_t i { 0 }; i < batch_size && strand != strands.end(); ++i, ++strand) {
+                for (unsigned segment { 0 }; segment < strand->segment_count; ++segment) {
+                    const auto first_vertex = strand->first_vertex + segment;
+
+                    float root_layer { (vertices[first_vertex + 0].z - volume.bounds.origin.z) / voxel_size.z };
+                    float tip_layer  { (vertices[first_vertex + 1].z - volume.bounds.origin.z) / voxel_size.z };
+
+                    // One layer of slack, for the rounding in the walk below.
+                    int first_slab = glm::clamp(std::floor(std::min(root_layer, tip_layer)) - 1.0f, 0.0f, last_layer) / BrickSize;
+                    int last_slab  = glm::clamp(std::floor(std::max(root_layer, tip_layer)) + 1.0f, 0.0f, last_layer) / BrickSize;
+
+                    for (int slab { first_slab }; slab <= last_slab; ++slab)
+                        batch_segments[slab].push_back(first_vertex);
+                }
+            }
+        }
+
+        // Full precision tangents are only kept around for the bricks of a
+        // slab while we're voxelizing it, instead of a 200 MiB dense grid.
+        // They're split by component so they can be resolved with SSE2.
+        struct PreciseBrick {
+            std::array<float, SparseVolume::BrickVoxels> weights; // length.
+            std::array<float, SparseVolume::BrickVoxels> tangent_x,
+                                                         tangent_y,
+                                                         tangent_z;
+        };
+
+        const int slab_bricks { volume.brick_resolution.x * volume.brick_resolution.y };
+
+        std::vector<std::vector<unsigned>> slab_brick_index(slab_count);
+        std::vector<std::vector<SparseVolume::Brick>> slab_brick_data(slab_count);
+
+        const glm::ivec3 grid { volume.resolution };
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int slab = 0; slab < slab_count; ++slab) {
+            const float first_slab_layer = slab * BrickSize;
+            const float last_slab_layer  = first_slab_layer + BrickSize;
+
+            auto& brick_index = slab_brick_index[slab];
+            brick_index.resize(slab_bricks, SparseVolume::EmptyBrick);
+
+            std::vector<PreciseBrick> precise_bricks;
+
+            auto find_brick = [&](const glm::ivec3& brick) -> std::size_t {
+                auto& brick_slot = brick_index[brick.x + brick.y*volume.brick_resolution.x];
+
+                if (brick_slot == SparseVolume::EmptyBrick) {
+                    brick_slot = static_cast<unsigned>(precise_bricks.size());
+                    precise_bricks.emplace_back();
+                    precise_bricks.back().weights.fill(0.0f);
+                    precise_bricks.back().tangent_x.fill(0.0f);
+                    precise_bricks.back().tangent_y.fill(0.0f);
+                    precise_bricks.back().tangent_z.fill(0.0f);
+                }
+
+                return brick_slot;
+            };
+
+            if (voxelizer == Voxelizer::Exact) {
+                const int first_voxel_layer { slab * BrickSize };
+                const int last_voxel_layer  { std::min(first_voxel_layer + BrickSize, grid.z) };
 
-        for (std::size_t i { 0 }; i < indices.size() - 1; i += 2) {
-            auto root { (vertices[indices[i]]     - volume.bounds.origin) / voxel_size };
-            auto tip  { (vertices[indices[i + 1]] - volume.bounds.origin) / voxel_size };
+                for (const auto& batch_segments : slab_segments)
+                for (const auto first_vertex : batch_segments[slab]) {
+                    const auto root { (vertices[first_vertex + 0] - volume.bounds.origin) / voxel_size };
+                    const auto tip  { (vertices[first_vertex + 1] - volume.bounds.origin) / voxel_size };
 
-            auto direction { tip - root };
-            float steps { glm::compMax(glm::abs(direction)) };
-            direction /= steps; // [-1, 1]
+                    const float length { glm::length(tip - root) }; // in voxels.
 
-            while (steps-- > 0.0f) {
-                auto voxel = glm::min(glm::floor(root), volume.resolution-1.0f);
-                int voxel_index = voxel.x + voxel.y*width + voxel.z*width*height;
-                if (volume.densities[voxel_index] != 255) {
-                    precise_tangents[voxel_index] += tangents[indices[i]];
-                    volume.densities[voxel_index] += 1;
+                    const auto& tangent = tangents[first_vertex];
+
+                    // Only traverse the voxels inside this slab (and volume).
+                    const glm::ivec3 lower_bound { 0, 0, first_voxel_layer };
+                    const glm::ivec3 upper_bound { grid.x, grid.y, last_voxel_layer };
+
+                    traverse_voxels(root, tip, lower_bound, upper_bound, [&](const glm::ivec3& voxel, float t_enter, float t_exit) {
+                        const glm::ivec3 brick { voxel / BrickSize };
+                        const glm::ivec3 local { voxel - brick * BrickSize };
+
+                        auto& precise_brick = precise_bricks[find_brick(brick)];
+
+                        int voxel_index = local.x + local.y*BrickSize + local.z*BrickSize*BrickSize;
+
+                        const float fraction { (t_exit - t_enter) * length };
+
+                        precise_brick.weights[voxel_index]   += fraction;
+                        precise_brick.tangent_x[voxel_index] += tangent.x * fraction;
+                        precise_brick.tangent_y[voxel_index] += tangent.y * fraction;
+                        precise_brick.tangent_z[voxel_index] += tangent.z * fraction;
+                    });
                 }
+            } else {
+                for (const auto& batch_segments : slab_segments)
+                for (const auto first_vertex : batch_segments[slab]) {
+                    auto root { (vertices[first_vertex + 0] - volume.bounds.origin) / voxel_size };
+                    auto tip  { (vertices[first_vertex + 1] - volume.bounds.origin) / voxel_size };
+
+                    auto direction { tip - root };
+                    float steps { glm::compMax(glm::abs(direction)) };
+                    direction /= steps; // [-1, 1]
+
+                    const auto& tangent = tangents[first_vertex];
+
+                    while (steps-- > 0.0f) {
+                        auto voxel = glm::min(glm::floor(root), volume.resolution-1.0f);
+                        if (voxel.z >= first_slab_layer && voxel.z < last_slab_layer) {
+                            glm::ivec3 position { voxel };
+                            glm::ivec3 brick { position / BrickSize };
+                            glm::ivec3 local { position - brick * BrickSize };
+
+                            auto& precise_brick = precise_bricks[find_brick(brick)];
+
+                            int voxel_index = local.x + local.y*BrickSize + local.z*BrickSize*BrickSize;
+                            if (precise_brick.weights[voxel_index] != 255.0f) {
+                                precise_brick.weights[voxel_index]   += 1.0f;
+                                precise_brick.tangent_x[voxel_index] += tangent.x;
+                                precise_brick.tangent_y[voxel_index] += tangent.y;
+                                precise_brick.tangent_z[voxel_index] += tangent.z;
+                            }
+                        }
+
+                        root += direction; // Move to the voxel we're going to rasterize.
+                    }
+                }
+            }
 
-                root += direction; // Move to the voxel we're going to rasterize.
+            auto& bricks = slab_brick_data[slab];
+            bricks.resize(precise_bricks.size());
+
+            // Densities are kept in fixed-point (the length in voxels, or the
+            // number of steps), and only go to 8-bit in to_dense(). Tangents
+            // are the weighted average, and both are packed 4 voxels at once.
+
+            for (std::size_t b { 0 }; b < bricks.size(); ++b) {
+                pack_densities(precise_bricks[b].weights.data(),
+                               bricks[b].densities.data(),
+                               SparseVolume::BrickVoxels);
+                resolve_tangents(precise_bricks[b].weights.data(),
+                                 precise_bricks[b].tangent_x.data(),
+                                 precise_bricks[b].tangent_y.data(),
+                                 precise_bricks[b].tangent_z.data(),
+                                 bricks[b].tangents.data(),
+                                 SparseVolume::BrickVoxels);
             }
         }
 
-        volume.tangents.resize(width * height * depth, glm::i8vec4 { 0, 0, 0, 0 });
+        // Stitch the slabs together in order, so the layout is deterministic.
+
+        std::size_t brick_count { 0 };
+        for (const auto& bricks : slab_brick_data)
+            brick_count += bricks.size();
+
+        volume.bricks.reserve(brick_count);
+        volume.brick_index.reserve(static_cast<std::size_t>(slab_bricks) * slab_count);
+
+        for (int slab { 0 }; slab < slab_count; ++slab) {
+            const auto first_brick = static_cast<unsigned>(volume.bricks.size());
+
+            for (auto brick : slab_brick_index[slab]) {
+                if (brick != SparseVolume::EmptyBrick) brick += first_brick;
+                volume.brick_index.push_back(brick);
+            }
+
+            volume.bricks.insert(volume.bricks.end(), slab_brick_data[slab].begin(),
+                                                      slab_brick_data[slab].end());
+            slab_brick_data[slab] = std::vector<SparseVolume::Brick> {  };
+        }
+
+        return volume;
+    }
+
+    float HairStyle::SparseVolume::get_density(int x, int y, int z) const {
+        const glm::ivec3 brick { x / BrickSize, y / BrickSize, z / BrickSize };
+        const auto slot = brick_index[brick.x + brick.y*brick_resolution.x + brick.z*brick_resolution.x*brick_resolution.y];
+        if (slot == EmptyBrick) return 0.0f;
+        const glm::ivec3 local { x - brick.x*BrickSize, y - brick.y*BrickSize, z - brick.z*BrickSize };
+        return bricks[slot].densities[local.x + local.y*BrickSize + local.z*BrickSize*BrickSize] / DensityScale;
+    }
+
+    glm::i8vec4 HairStyle::SparseVolume::get_tangent(int x, int y, int z) const {
+        const glm::ivec3 brick { x / BrickSize, y / BrickSize, z / BrickSize };
+        const auto slot = brick_index[brick.x + brick.y*brick_resolution.x + brick.z*brick_resolution.x*brick_resolution.y];
+        if (slot == EmptyBrick) return glm::i8vec4 { 0, 0, 0, 0 };
+        const glm::ivec3 local { x - brick.x*BrickSize, y - brick.y*BrickSize, z - brick.z*BrickSize };
+        return bricks[slot].tangents[local.x + local.y*BrickSize + local.z*BrickSize*BrickSize];
+    }
+
+    void HairStyle::SparseVolume::normalize() {
+        std::uint16_t data_min { 0xFFFF }, data_max { 0 };
+
+        // Empty bricks, and the voxels outside the volume, count as zeros.
+        if (bricks.size() != brick_index.size()) data_min = 0;
+
+        for (const auto& brick : bricks) {
+            for (const auto density : brick.densities) {
+                if (density > data_max) data_max = density;
+                if (density < data_min) data_min = density;
+            }
+        }
+
+        if (data_max <= data_min) return;
+
+        float scaling { 255.0f * DensityScale / (data_max - data_min) };
+
+        // Anything above the minimum stays above zero after normalization.
+        for (auto& brick : bricks) {
+            for (auto& density : brick.densities) {
+                if (density <= data_min) density = 0;
+                else density = static_cast<std::uint16_t>(std::max(std::round((density - data_min) * scaling), 1.0f));
+            }
+        }
+    }
+
+    HairStyle::Volume HairStyle::SparseVolume::to_dense() const {
+        Volume volume {
+            resolution,
+            bounds,
+            {  }, {  }
+        };
+
+        const glm::ivec3 grid { resolution };
+
+        volume.densities.resize(grid.x * grid.y * grid.z, 0);
+        volume.tangents.resize(grid.x * grid.y * grid.z, glm::i8vec4 { 0, 0, 0, 0 });
 
         #pragma omp parallel for schedule(dynamic)
-        for (int i = 0; i < volume.densities.size(); ++i) {
-            glm::i8vec3 quantized  = precise_tangents[i] / static_cast<float>(volume.densities[i]) * 127.0f;
-            volume.tangents[i].x   = quantized.x;
-            volume.tangents[i].y   = quantized.y;
-            volume.tangents[i].z   = quantized.z;
+        for (int k = 0; k < brick_resolution.z; ++k)
+        for (int j = 0; j < brick_resolution.y; ++j)
+        for (int i = 0; i < brick_resolution.x; ++i) {
+            const auto slot = brick_index[i + j*brick_resolution.x + k*brick_resolution.x*brick_resolution.y];
+
+            if (slot == EmptyBrick) continue;
+
+            const auto& brick = bricks[slot];
+
+            std::array<unsigned char, BrickVoxels> densities;
+            quantize_densities(brick.densities.data(), densities.data(), BrickVoxels);
+
+            for (int z = 0; z < BrickSize && k*BrickSize + z < grid.z; ++z)
+            for (int y = 0; y < BrickSize && j*BrickSize + y < grid.y; ++y)
+            for (int x = 0; x < BrickSize && i*BrickSize + x < grid.x; ++x) {
+                std::size_t index = (i*BrickSize + x) + (j*BrickSize + y)*grid.x + (k*BrickSize + z)*grid.x*grid.y;
+                volume.densities[index] = densities[x + y*BrickSize + z*BrickSize*BrickSize];
+                volume.tangents[index]  = brick.tangents[x + y*BrickSize + z*BrickSize*BrickSize];
+            }
         }
 
         return volume;
     }
 
+    void HairStyle::resolve_tangents(const float* weights, const float* x, const float* y, const float* z,
+                                     glm::i8vec4* tangents, std::size_t count) {
+        const __m128 zero  { _mm_setzero_ps() };
+        const __m128 upper { _mm_set1_ps(+127.0f) };
+        const __m128 lower { _mm_set1_ps(-127.0f) };
+        const __m128i byte { _mm_set1_epi32(0xFF) };
+
+        std::size_t i { 0 };
+
+        for (; i + 4 <= count; i += 4) {
+            const __m128 weight { _mm_loadu_ps(weights + i) };
+            // Voxels without any hair have a zero tangent, not a NaN one.
+            const __m128 has_hair { _mm_cmpgt_ps(weight, zero) };
+
+            // Average first and then scale, like the old dense voxelizer did.
+            auto quantize = [&](const float* component) {
+                __m128 tangent { _mm_mul_ps(_mm_div_ps(_mm_loadu_ps(component + i), weight), upper) };
+                tangent = _mm_and_ps(_mm_min_ps(_mm_max_ps(tangent, lower), upper), has_hair);
+                return _mm_and_si128(_mm_cvttps_epi32(tangent), byte); // truncates.
+            };
+
+            // Each 32-bit lane becomes an i8vec4 { x, y, z, 0 } in memory.
+            const __m128i packed { _mm_or_si128(quantize(x),
+                                   _mm_or_si128(_mm_slli_epi32(quantize(y),  8),
+                                                _mm_slli_epi32(quantize(z), 16))) };
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(tangents + i), packed);
+        }
+
+        for (; i < count; ++i) {
+            tangents[i] = glm::i8vec4 { 0, 0, 0, 0 };
+            if (weights[i] <= 0.0f) continue;
+            glm::i8vec3 quantized = glm::clamp(glm::vec3 { x[i], y[i], z[i] } / weights[i] * 127.0f, -127.0f, 127.0f);
+            tangents[i].x = quantized.x;
+            tangents[i].y = quantized.y;
+            tangents[i].z = quantized.z;
+        }
+    }
+
+    void HairStyle::pack_densities(const float* weights, std::uint16_t* densities, std::size_t count) {
+        const __m128 zero  { _mm_setzero_ps() };
+        const __m128 upper { _mm_set1_ps(65535.0f) };
+        const __m128 lower { _mm_set1_ps(1.0f) };
+        const __m128 scale { _mm_set1_ps(SparseVolume::DensityScale) };
+        // SSE2 can only pack to signed 16-bit, so bias it and flip it back.
+        const __m128i bias32 { _mm_set1_epi32(32768) };
+        const __m128i bias16 { _mm_set1_epi16(-32768) };
+
+        std::size_t i { 0 };
+
+        for (; i + 8 <= count; i += 8) {
+            __m128i words[2];
+
+            for (int j { 0 }; j < 2; ++j) {
+                const __m128 weight { _mm_loadu_ps(weights + i + 4*j) };
+                __m128 scaled { _mm_min_ps(_mm_max_ps(_mm_mul_ps(weight, scale), lower), upper) };
+                scaled = _mm_and_ps(scaled, _mm_cmpgt_ps(weight, zero));
+                words[j] = _mm_sub_epi32(_mm_cvtps_epi32(scaled), bias32); // rounds to nearest.
+            }
+
+            const __m128i packed { _mm_xor_si128(_mm_packs_epi32(words[0], words[1]), bias16) };
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(densities + i), packed);
+        }
+
+        for (; i < count; ++i) {
+            if (weights[i] <= 0.0f) densities[i] = 0;
+            else densities[i] = static_cast<std::uint16_t>(glm::clamp(std::nearbyint(weights[i] * SparseVolume::DensityScale), 1.0f, 65535.0f));
+        }
+    }
+
+    void HairStyle::quantize_densities(const std::uint16_t* densities, unsigned char* quantized, std::size_t count) {
+        const __m128i zero { _mm_setzero_si128() };
+        const __m128i half { _mm_set1_epi16(128) };
+        const __m128i one  { _mm_set1_epi16(1) };
+
+        std::size_t i { 0 };
+
+        for (; i + 16 <= count; i += 16) {
+            __m128i words[2];
+
+            for (int j { 0 }; j < 2; ++j) {
+                const __m128i density { _mm_loadu_si128(reinterpret_cast<const __m128i*>(densities + i + 8*j)) };
+                // Rounds to nearest (saturating at 255), but never down to 0.
+                const __m128i rounded { _mm_srli_epi16(_mm_adds_epu16(density, half), 8) };
+                const __m128i has_hair { _mm_andnot_si128(_mm_cmpeq_epi16(density, zero), one) };
+                words[j] = _mm_max_epi16(rounded, has_hair);
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(quantized + i), _mm_packus_epi16(words[0], words[1]));
+        }
+
+        for (; i < count; ++i) {
+            if (densities[i] == 0) quantized[i] = 0;
+            else quantized[i] = static_cast<unsigned char>(std::max(std::min((densities[i] + 128) >> 8, 255), 1));
+        }
+    }
+
+    std::size_t HairStyle::SparseVolume::get_size() const {
+        return brick_index.size() * sizeof(brick_index[0]) +
+               bricks.size() * sizeof(bricks[0]);
+    }
+
+    bool HairStyle::has_volume() const {
+        return prepared_volume != nullptr;
+    }
+
+    const HairStyle::SparseVolume& HairStyle::get_volume() const {
+        return *prepared_volume;
+    }
+
+    std::shared_ptr<const HairStyle::SparseVolume> HairStyle::get_shared_volume() const {
+        return prepared_volume;
+    }
+
+    void HairStyle::set_volume(SparseVolume&& volume) {
+        prepared_volume = std::make_shared<const SparseVolume>(std::move(volume));
+    }
+
+    void HairStyle::clear_volume() {
+        prepared_volume.reset();
+    }
+
     void HairStyle::Volume::normalize() {
         unsigned char data_min { 255 }, data_max { 0 };
         for (std::size_t i { 0 }; i < densities.size(); ++i) {
@@ -356,6 +1068,131 @@ namespace vkhr {
         }
     }
 
+    HairStyle::Volume HairStyle::Volume::build_mip_level(Filter filter) const {
+        const glm::ivec3 source { resolution };
+        const glm::ivec3 target { // rounds up.
+            (source.x + 1) / 2,
+            (source.y + 1) / 2,
+            (source.z + 1) / 2
+        };
+
+        Volume volume {
+            target,
+            bounds, // no change
+            {  }, {  }
+        };
+
+        volume.densities.resize(target.x * target.y * target.z);
+        volume.tangents.resize(target.x * target.y * target.z);
+
+        // Each output row reads two rows in two slices of the level above,
+        // that are contiguous in x, so the inner loops can be vectorized.
+        // Odd sizes repeat the last voxel, instead of dropping or reading past it.
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < target.z; ++k)
+        for (int j = 0; j < target.y; ++j) {
+            const int z0 { std::min(2*k + 0, source.z - 1) }, z1 { std::min(2*k + 1, source.z - 1) };
+            const int y0 { std::min(2*j + 0, source.y - 1) }, y1 { std::min(2*j + 1, source.y - 1) };
+
+            const std::size_t rows[4] {
+                static_cast<std::size_t>(y0*source.x + z0*source.x*source.y),
+                static_cast<std::size_t>(y1*source.x + z0*source.x*source.y),
+                static_cast<std::size_t>(y0*source.x + z1*source.x*source.y),
+                static_cast<std::size_t>(y1*source.x + z1*source.x*source.y)
+            };
+
+            const unsigned char* d0 { &densities[rows[0]] };
+            const unsigned char* d1 { &densities[rows[1]] };
+            const unsigned char* d2 { &densities[rows[2]] };
+            const unsigned char* d3 { &densities[rows[3]] };
+
+            const std::size_t output_row = j*target.x + k*target.x*target.y;
+
+            unsigned char* density { &volume.densities[output_row] };
+
+            const int last_x { source.x - 1 };
+
+            switch (filter) {
+            case Filter::Box:
+                for (int i = 0; i < target.x; ++i) {
+                    const int x0 { std::min(2*i + 0, last_x) }, x1 { std::min(2*i + 1, last_x) };
+                    unsigned sum = d0[x0] + d0[x1] + d1[x0] + d1[x1] +
+                                   d2[x0] + d2[x1] + d3[x0] + d3[x1];
+                    density[i] = static_cast<unsigned char>((sum + 4) / 8);
+                }
+                break;
+            case Filter::Max:
+                for (int i = 0; i < target.x; ++i) {
+                    const int x0 { std::min(2*i + 0, last_x) }, x1 { std::min(2*i + 1, last_x) };
+                    unsigned char a = std::max(std::max(d0[x0], d0[x1]), std::max(d1[x0], d1[x1]));
+                    unsigned char b = std::max(std::max(d2[x0], d2[x1]), std::max(d3[x0], d3[x1]));
+                    density[i] = std::max(a, b);
+                }
+                break;
+            case Filter::Min:
+                for (int i = 0; i < target.x; ++i) {
+                    const int x0 { std::min(2*i + 0, last_x) }, x1 { std::min(2*i + 1, last_x) };
+                    unsigned char a = std::min(std::min(d0[x0], d0[x1]), std::min(d1[x0], d1[x1]));
+                    unsigned char b = std::min(std::min(d2[x0], d2[x1]), std::min(d3[x0], d3[x1]));
+                    density[i] = std::min(a, b);
+                }
+                break;
+            }
+
+            const glm::i8vec4* t[4] {
+                &tangents[rows[0]],
+                &tangents[rows[1]],
+                &tangents[rows[2]],
+                &tangents[rows[3]]
+            };
+
+            const unsigned char* d[4] { d0, d1, d2, d3 };
+
+            glm::i8vec4* tangent { &volume.tangents[output_row] };
+
+            for (int i = 0; i < target.x; ++i) {
+                const int x0 { std::min(2*i + 0, last_x) }, x1 { std::min(2*i + 1, last_x) };
+
+                int weight { 0 }, x { 0 }, y { 0 }, z { 0 };
+
+                for (int row { 0 }; row < 4; ++row) {
+                    weight += d[row][x0] + d[row][x1];
+                    x += t[row][x0].x * d[row][x0] + t[row][x1].x * d[row][x1];
+                    y += t[row][x0].y * d[row][x0] + t[row][x1].y * d[row][x1];
+                    z += t[row][x0].z * d[row][x0] + t[row][x1].z * d[row][x1];
+                }
+
+                if (weight == 0) {
+                    tangent[i] = glm::i8vec4 { 0, 0, 0, 0 };
+                } else {
+                    tangent[i] = glm::i8vec4 {
+                        static_cast<std::int8_t>(x / weight),
+                        static_cast<std::int8_t>(y / weight),
+                        static_cast<std::int8_t>(z / weight),
+                        0
+                    };
+                }
+            }
+        }
+
+        return volume;
+    }
+
+    std::vector<HairStyle::Volume> HairStyle::Volume::build_mip_chain(Filter filter) const {
+        std::vector<Volume> mip_chain;
+
+        glm::ivec3 level_resolution { resolution };
+
+        while (level_resolution.x > 1 || level_resolution.y > 1 || level_resolution.z > 1) {
+            if (mip_chain.empty()) mip_chain.push_back(build_mip_level(filter));
+            else mip_chain.push_back(mip_chain.back().build_mip_level(filter));
+            level_resolution = mip_chain.back().resolution;
+        }
+
+        return mip_chain;
+    }
+
     bool HairStyle::Volume::save(const std::string& file_path) {
         std::ofstream file { file_path, std::ios::binary };
         if (!file) return false; // Couldn't write to file.
@@ -376,6 +1213,12 @@ namespace vkhr {
         unsigned strands_left = get_strand_count() - std::ceil(get_strand_count() * ratio);
         unsigned vertex_count = get_vertex_count() - std::ceil(get_vertex_count() * ratio);
 
+        const bool had_indices { has_indices() };
+        const bool had_strand_offsets { has_strand_offsets() };
+        const bool had_position_arrays { has_position_arrays() };
+
+        if (!had_strand_offsets) generate_strand_offsets();
+
         std::vector<unsigned short> reduced_segments;
         std::vector<glm::vec3> reduced_vertices;
         std::vector<float> reduced_thickness;
@@ -391,24 +1234,17 @@ namespace vkhr {
         if (has_transparency()) reduced_transparency.reserve(vertex_count);
         if (has_color()) reduced_color.reserve(vertex_count);
 
-        std::vector<std::size_t> strand_offset(get_strand_count());
+        // Segments are shuffled in-place below, so they need to be copied.
+        materialize_field(segments, mapped.segments);
 
-        if (has_segments()) {
-            std::copy(segments.begin(), segments.end(), strand_offset.begin() + 1);
-            std::transform(strand_offset.begin(), strand_offset.end(),
-                           strand_offset.begin(), [](std::size_t i) { return i + 1; });
-            strand_offset[0] = 0;
-            std::partial_sum(strand_offset.begin(),
-                             strand_offset.end(),
-                             strand_offset.begin());
-        } else {
-            auto vertices_per_segment = get_default_segment_count() + 1;
-            std::fill(strand_offset.begin() + 1, strand_offset.end(), vertices_per_segment);
-            strand_offset[0] = 0;
-            std::partial_sum(strand_offset.begin(),
-                             strand_offset.end(),
-                             strand_offset.begin());
-        }
+        const auto vertices = get_vertices_view();
+        const auto thickness = get_thickness_view();
+        const auto tangents = get_tangents_view();
+        const auto transparency = get_transparency_view();
+        const auto color = get_color_view();
+
+        // Strands are picked (and removed) at random, so we need a copy.
+        std::vector<std::size_t> strand_offset(strand_offsets.begin(), strand_offsets.end() - 1);
 
         while (--strands_left && strand_offset.size() != 0) {
             double random = xorshift64(&seed) / static_cast<double>(std::numeric_limits<std::uint64_t>::max());
@@ -437,59 +1273,75 @@ namespace vkhr {
             strand_offset.pop_back();
         }
 
+        // All fields now live in the vectors, so the file can go away.
+        release_mapping();
+
         segments = reduced_segments;
-        vertices = reduced_vertices;
+        this->vertices = reduced_vertices;
+
+        // Only re-build the index buffer if somebody asked for it before.
+        indices.clear();
+        if (had_indices) generate_indices();
 
-        generate_indices();
+        strand_offsets.clear();
+        if (had_strand_offsets) generate_strand_offsets();
+        clear_position_arrays();
+        if (had_position_arrays) generate_position_arrays();
 
-        thickness = reduced_thickness;
-        tangents = reduced_tangents;
-        transparency = reduced_transparency;
-        color = reduced_color;
+        this->thickness = reduced_thickness;
+        this->tangents = reduced_tangents;
+        this->transparency = reduced_transparency;
+        this->color = reduced_color;
     }
 
     std::vector<glm::vec4> HairStyle::create_position_thickness_data() const {
+        const auto vertex_view = get_vertices_view();
+        const auto thickness_view = get_thickness_view();
         std::vector<glm::vec4> position_thicknesses(get_vertex_count());
         #pragma omp parallel for schedule(dynamic)
         for (int i = 0; i < static_cast<int>(get_vertex_count()); ++i) {
             float thickness { 0.042f };
             if (has_thickness())
-                thickness = this->thickness[i];
+                thickness = thickness_view[i];
 
             position_thicknesses[i] = glm::vec4 {
-                vertices[i],
+                vertex_view[i],
                 thickness
             };
         } return position_thicknesses;
     }
 
     std::vector<glm::vec4> HairStyle::create_tangent_transparency_data() const {
+        const auto tangent_view = get_tangents_view();
+        const auto transparency_view = get_transparency_view();
         std::vector<glm::vec4> tangent_transparency(get_vertex_count());
         #pragma omp parallel for schedule(dynamic)
         for (int i = 0; i < static_cast<int>(get_vertex_count()); ++i) {
             float transparency { get_default_transparency() };
             if (has_transparency())
-                transparency = this->transparency[i];
+                transparency = transparency_view[i];
 
             tangent_transparency[i] = glm::vec4 {
-                tangents[i],
+                tangent_view[i],
                 transparency
             };
         } return tangent_transparency;
     }
 
     std::vector<glm::vec4> HairStyle::create_color_transparency_data() const {
+        const auto color_view = get_color_view();
+        const auto transparency_view = get_transparency_view();
         std::vector<glm::vec4> color_transparencies(get_vertex_count());
         #pragma omp parallel for schedule(dynamic)
         for (int i = 0; i < static_cast<int>(get_vertex_count()); ++i) {
             float transparency { get_default_transparency() };
             if (has_transparency()) {
-                transparency = this->transparency[i];
+                transparency = transparency_view[i];
             }
 
             glm::vec3 color { get_default_color() };
             if (has_color()) {
-                color = this->color[i];
+                color = color_view[i];
             }
 
             color_transparencies[i] = glm::vec4 {
@@ -500,33 +1352,68 @@ namespace vkhr {
     }
 
     const std::vector<unsigned>& HairStyle::get_indices() const {
+        assert(!is_mapped());
         return indices;
     }
 
     const std::vector<glm::vec3>& HairStyle::get_tangents() const {
+        assert(!is_mapped());
         return tangents;
     }
 
     const std::vector<float>& HairStyle::get_thickness() const {
+        assert(!is_mapped());
         return thickness;
     }
 
     const std::vector<glm::vec3>& HairStyle::get_vertices() const {
+        assert(!is_mapped());
         return vertices;
     }
 
     const std::vector<unsigned short>& HairStyle::get_segments() const {
+        assert(!is_mapped());
         return segments;
     }
 
     const std::vector<float>& HairStyle::get_transparency() const {
+        assert(!is_mapped());
         return transparency;
     }
 
     const std::vector<glm::vec3>& HairStyle::get_color() const {
+        assert(!is_mapped());
         return color;
     }
 
+    ArrayView<unsigned short> HairStyle::get_segments_view() const {
+        return view_field(segments, mapped.segments);
+    }
+
+    ArrayView<glm::vec3> HairStyle::get_vertices_view() const {
+        return view_field(vertices, mapped.vertices);
+    }
+
+    ArrayView<float> HairStyle::get_thickness_view() const {
+        return view_field(thickness, mapped.thickness);
+    }
+
+    ArrayView<float> HairStyle::get_transparency_view() const {
+        return view_field(transparency, mapped.transparency);
+    }
+
+    ArrayView<glm::vec3> HairStyle::get_color_view() const {
+        return view_field(color, mapped.color);
+    }
+
+    ArrayView<glm::vec3> HairStyle::get_tangents_view() const {
+        return view_field(tangents, mapped.tangents);
+    }
+
+    ArrayView<unsigned> HairStyle::get_indices_view() const {
+        return view_field(indices, mapped.indices);
+    }
+
     bool HairStyle::valid_signature() const {
         return file_header.signature[0] == 'H' &&
                file_header.signature[1] == 'A' &&
@@ -537,9 +1424,9 @@ namespace vkhr {
     bool HairStyle::format_is_valid() const {
         if (!has_vertices()) return false;
         if (!valid_signature()) return false;
-        if (has_thickness() && thickness.size() != vertices.size()) return false;
-        if (has_transparency() && transparency.size() != vertices.size()) return false;
-        if (has_color() && color.size() != vertices.size()) return false;
+        if (has_thickness() && get_thickness_view().size() != get_vertex_count()) return false;
+        if (has_transparency() && get_transparency_view().size() != get_vertex_count()) return false;
+        if (has_color() && get_color_view().size() != get_vertex_count()) return false;
         return true; // The rest we assume is right. It's hard to verify.
     }
 
@@ -563,6 +1450,7 @@ namespace vkhr {
         file_header.field.has_color = has_color();
         file_header.field.has_tangents = has_tangents();
         file_header.field.has_indices = has_indices();
+        file_header.field.compression = 0;
         file_header.field.future_extension = 0;
     }
 
@@ -582,6 +1470,8 @@ namespace vkhr {
 
     bool HairStyle::read_vertices(std::ifstream& file) {
         if (file_header.field.has_vertices) {
+            if (file_header.field.compression)
+                return read_quantized_vertices(file);
             vertices.resize(file_header.vertex_count);
             return read_field(file, vertices);
         } return true;
@@ -589,6 +1479,8 @@ namespace vkhr {
 
     bool HairStyle::read_thickness(std::ifstream& file) {
         if (file_header.field.has_thickness) {
+            if (file_header.field.compression)
+                return read_quantized_thickness(file);
             thickness.resize(file_header.vertex_count);
             return read_field(file, thickness);
         } return true;
@@ -596,6 +1488,8 @@ namespace vkhr {
 
     bool HairStyle::read_transparancy(std::ifstream& file) {
         if (file_header.field.has_transparency) {
+            if (file_header.field.compression)
+                return read_quantized_transparency(file);
             transparency.resize(file_header.vertex_count);
             return read_field(file, transparency);
         } return true;
@@ -610,6 +1504,8 @@ namespace vkhr {
 
     bool HairStyle::read_tangents(std::ifstream& file) {
         if (file_header.field.has_tangents) {
+            if (file_header.field.compression)
+                return read_quantized_tangents(file);
             tangents.resize(file_header.vertex_count);
             return read_field(file, tangents);
         } return true;
@@ -617,61 +1513,409 @@ namespace vkhr {
 
     bool HairStyle::read_indices(std::ifstream& file) {
         if (file_header.field.has_indices) {
+            if (file_header.field.compression && compression_header.implicit_indices) {
+                generate_indices();
+                return true;
+            }
+
             indices.resize(get_segment_count() * 2);
             return read_field(file, indices);
         } return true;
     }
 
-    bool HairStyle::write_segments(std::ofstream& file) const {
-        if (file_header.field.has_segments) {
-            return write_field(file, segments);
+    bool HairStyle::write_segments(std::ofstream& file, const FileHeader& header) const {
+        if (header.field.has_segments) {
+            return write_field(file, get_segments_view());
         } return true;
     }
 
-    bool HairStyle::write_vertices(std::ofstream& file) const {
-        if (file_header.field.has_vertices) {
-            return write_field(file, vertices);
+    bool HairStyle::write_vertices(std::ofstream& file, const FileHeader& header, const CompressionHeader& compression) const {
+        if (header.field.has_vertices) {
+            if (header.field.compression)
+                return write_quantized_vertices(file, header, compression);
+            return write_field(file, get_vertices_view());
         } return true;
     }
 
-    bool HairStyle::write_thickness(std::ofstream& file) const {
-        if (file_header.field.has_thickness) {
-            return write_field(file, thickness);
+    bool HairStyle::write_thickness(std::ofstream& file, const FileHeader& header, const CompressionHeader& compression) const {
+        if (header.field.has_thickness) {
+            if (header.field.compression)
+                return write_quantized_thickness(file, compression);
+            return write_field(file, get_thickness_view());
         } return true;
     }
 
-    bool HairStyle::write_transparancy(std::ofstream& file) const {
-        if (file_header.field.has_transparency) {
-            return write_field(file, transparency);
+    bool HairStyle::write_transparancy(std::ofstream& file, const FileHeader& header, const CompressionHeader& compression) const {
+        if (header.field.has_transparency) {
+            if (header.field.compression)
+                return write_quantized_transparency(file, compression);
+            return write_field(file, get_transparency_view());
         } return true;
     }
 
-    bool HairStyle::write_color(std::ofstream& file) const {
-        if (file_header.field.has_color) {
-            return write_field(file, color);
+    bool HairStyle::write_color(std::ofstream& file, const FileHeader& header) const {
+        if (header.field.has_color) {
+            return write_field(file, get_color_view());
         } return true;
     }
 
-    bool HairStyle::write_tangents(std::ofstream& file) const {
-        if (file_header.field.has_tangents) {
-            return write_field(file, tangents);
+    bool HairStyle::write_tangents(std::ofstream& file, const FileHeader& header) const {
+        if (header.field.has_tangents) {
+            if (header.field.compression)
+                return write_quantized_tangents(file);
+            return write_field(file, get_tangents_view());
         } return true;
     }
 
-    bool HairStyle::write_indices(std::ofstream& file) const {
-        if (file_header.field.has_indices) {
-            return write_field(file, indices);
+    bool HairStyle::write_indices(std::ofstream& file, const FileHeader& header, const CompressionHeader& compression) const {
+        if (header.field.has_indices) {
+            if (header.field.compression && compression.implicit_indices)
+                return true;
+            return write_field(file, get_indices_view());
         } return true;
     }
 
+    bool HairStyle::read_compression_header(std::ifstream& file) {
+        if (!file.read(reinterpret_cast<char*>(&compression_header), sizeof(CompressionHeader)))
+            return false;
+        update_quantization_error(file_header, compression_header);
+        return true;
+    }
+
+    bool HairStyle::read_quantized_vertices(std::ifstream& file) {
+        std::vector<glm::u16vec3> roots(get_strand_count());
+        std::vector<glm::i16vec3> deltas(file_header.vertex_count);
+
+        if (!read_field(file, roots) || !read_field(file, deltas))
+            return false;
+
+        const auto segments = get_segments_view();
+
+        vertices.resize(deltas.size());
+
+        std::size_t vertex { 0 };
+        for (std::size_t strand { 0 }; strand < roots.size(); ++strand) {
+            unsigned segment_count { get_default_segment_count() };
+
+            if (has_segments()) segment_count = segments[strand];
+
+            const auto root = dequantize_root(roots[strand], get_bounding_box());
+
+            for (std::size_t i { 0 }; i <= segment_count && vertex < vertices.size(); ++i, ++vertex)
+                vertices[vertex] = root + glm::vec3 { deltas[vertex] } * compression_header.position_scale;
+        }
+
+        return vertex == vertices.size();
+    }
+
+    bool HairStyle::read_quantized_thickness(std::ifstream& file) {
+        std::vector<unsigned char> quantized_thickness(file_header.vertex_count);
+
+        if (!read_field(file, quantized_thickness))
+            return false;
+
+        const float minimum { compression_header.thickness_range[0] },
+                    range   { compression_header.thickness_range[1] - minimum };
+
+        thickness.resize(quantized_thickness.size());
+
+        for (std::size_t i { 0 }; i < thickness.size(); ++i)
+            thickness[i] = minimum + (quantized_thickness[i] / 255.0f) * range;
+
+        return true;
+    }
+
+    bool HairStyle::read_quantized_transparency(std::ifstream& file) {
+        std::vector<unsigned char> quantized_transparency(file_header.vertex_count);
+
+        if (!read_field(file, quantized_transparency))
+            return false;
+
+        const float minimum { compression_header.transparency_range[0] },
+                    range   { compression_header.transparency_range[1] - minimum };
+
+        transparency.resize(quantized_transparency.size());
+
+        for (std::size_t i { 0 }; i < transparency.size(); ++i)
+            transparency[i] = minimum + (quantized_transparency[i] / 255.0f) * range;
+
+        return true;
+    }
+
+    bool HairStyle::read_quantized_tangents(std::ifstream& file) {
+        std::vector<glm::i8vec2> encoded_tangents(file_header.vertex_count);
+
+        if (!read_field(file, encoded_tangents))
+            return false;
+
+        tangents.resize(encoded_tangents.size());
+
+        for (std::size_t i { 0 }; i < tangents.size(); ++i)
+            tangents[i] = decode_octahedral(encoded_tangents[i]);
+
+        return true;
+    }
+
+    bool HairStyle::write_compression_header(std::ofstream& file, const CompressionHeader& compression) const {
+        if (!file.write(reinterpret_cast<const char*>(&compression), sizeof(CompressionHeader)))
+            return false;
+        return true;
+    }
+
+    bool HairStyle::write_quantized_vertices(std::ofstream& file, const FileHeader& header, const CompressionHeader& compression) const {
+        const auto segments = get_segments_view();
+        const auto vertices = get_vertices_view();
+        const auto bounds = get_bounding_box(header);
+
+        std::vector<glm::u16vec3> roots;
+        std::vector<glm::i16vec3> deltas;
+
+        roots.reserve(get_strand_count());
+        deltas.reserve(vertices.size());
+
+        const float scale { compression.position_scale };
+
+        std::size_t vertex { 0 };
+        for (std::size_t strand { 0 }; strand < get_strand_count(); ++strand) {
+            unsigned segment_count { get_default_segment_count() };
+
+            if (has_segments()) segment_count = segments[strand];
+
+            if (vertex >= vertices.size()) return false;
+
+            // Deltas are relative to the root we'll decode, not the real one,
+            // so the root's own quantization error doesn't accumulate here.
+            roots.push_back(quantize_root(vertices[vertex], bounds));
+            const auto root = dequantize_root(roots.back(), bounds);
+
+            for (std::size_t i { 0 }; i <= segment_count && vertex < vertices.size(); ++i, ++vertex) {
+                glm::vec3 delta { 0.0f };
+
+                if (scale > 0.0f) delta = (vertices[vertex] - root) / scale;
+
+                deltas.emplace_back(static_cast<short>(std::round(glm::clamp(delta.x, -32767.0f, 32767.0f))),
+                                    static_cast<short>(std::round(glm::clamp(delta.y, -32767.0f, 32767.0f))),
+                                    static_cast<short>(std::round(glm::clamp(delta.z, -32767.0f, 32767.0f))));
+            }
+        }
+
+        if (!write_field(file, ArrayView<glm::u16vec3> { roots }))
+            return false;
+        return write_field(file, ArrayView<glm::i16vec3> { deltas });
+    }
+
+    bool HairStyle::write_quantized_thickness(std::ofstream& file, const CompressionHeader& compression) const {
+        const float minimum { compression.thickness_range[0] },
+                    range   { compression.thickness_range[1] - minimum };
+
+        std::vector<unsigned char> quantized_thickness;
+        quantized_thickness.reserve(get_vertex_count());
+
+        for (const auto radius : get_thickness_view()) {
+            float normalized { 0.0f };
+            if (range > 0.0f) normalized = (radius - minimum) / range;
+            quantized_thickness.push_back(static_cast<unsigned char>(std::round(glm::clamp(normalized, 0.0f, 1.0f) * 255.0f)));
+        }
+
+        return write_field(file, ArrayView<unsigned char> { quantized_thickness });
+    }
+
+    bool HairStyle::write_quantized_transparency(std::ofstream& file, const CompressionHeader& compression) const {
+        const float minimum { compression.transparency_range[0] },
+                    range   { compression.transparency_range[1] - minimum };
+
+        std::vector<unsigned char> quantized_transparency;
+        quantized_transparency.reserve(get_vertex_count());
+
+        for (const auto alpha : get_transparency_view()) {
+            float normalized { 0.0f };
+            if (range > 0.0f) normalized = (alpha - minimum) / range;
+            quantized_transparency.push_back(static_cast<unsigned char>(std::round(glm::clamp(normalized, 0.0f, 1.0f) * 255.0f)));
+        }
+
+        return write_field(file, ArrayView<unsigned char> { quantized_transparency });
+    }
+
+    bool HairStyle::write_quantized_tangents(std::ofstream& file) const {
+        std::vector<glm::i8vec2> encoded_tangents;
+        encoded_tangents.reserve(get_vertex_count());
+
+        for (const auto& tangent : get_tangents_view())
+            encoded_tangents.push_back(encode_octahedral(tangent));
+
+        return write_field(file, ArrayView<glm::i8vec2> { encoded_tangents });
+    }
+
+    void HairStyle::prepare_compression_header(FileHeader& header, CompressionHeader& compression) const {
+        const auto segments = get_segments_view();
+        const auto vertices = get_vertices_view();
+
+        // The roots are quantized against the stored AABB, so it must exist.
+        if (!header.field.has_bounding_box && !vertices.empty()) {
+            glm::vec3 min_aabb { vertices.front() },
+                      max_aabb { vertices.front() };
+
+            for (const auto& position : vertices) {
+                min_aabb = glm::min(position, min_aabb);
+                max_aabb = glm::max(position, max_aabb);
+            }
+
+            std::memcpy(&header.bounding_box_min[0], &min_aabb[0], sizeof(min_aabb));
+            std::memcpy(&header.bounding_box_max[0], &max_aabb[0], sizeof(max_aabb));
+
+            header.field.has_bounding_box = true;
+        }
+
+        // Largest distance from a vertex to its (decoded) strand root decides
+        // the step size of the 16-bit deltas, strands are short compared to
+        // the entire style so this is a lot finer than absolute quantization.
+
+        const auto bounds = get_bounding_box(header);
+
+        float largest_delta { 0.0f };
+
+        std::size_t vertex { 0 };
+        for (std::size_t strand { 0 }; strand < get_strand_count() && vertex < vertices.size(); ++strand) {
+            unsigned segment_count { get_default_segment_count() };
+
+            if (has_segments()) segment_count = segments[strand];
+
+            const auto root = dequantize_root(quantize_root(vertices[vertex], bounds), bounds);
+
+            for (std::size_t i { 0 }; i <= segment_count && vertex < vertices.size(); ++i, ++vertex) {
+                const auto delta = glm::abs(vertices[vertex] - root);
+                largest_delta = glm::max(largest_delta, glm::compMax(delta));
+            }
+        }
+
+        compression.position_scale = largest_delta / 32767.0f;
+
+        const auto thickness = get_thickness_view();
+        const auto transparency = get_transparency_view();
+
+        compression.thickness_range[0] = 0.0f;
+        compression.thickness_range[1] = 0.0f;
+
+        if (!thickness.empty()) {
+            const auto range = std::minmax_element(thickness.begin(), thickness.end());
+            compression.thickness_range[0] = *range.first;
+            compression.thickness_range[1] = *range.second;
+        }
+
+        compression.transparency_range[0] = 0.0f;
+        compression.transparency_range[1] = 0.0f;
+
+        if (!transparency.empty()) {
+            const auto range = std::minmax_element(transparency.begin(), transparency.end());
+            compression.transparency_range[0] = *range.first;
+            compression.transparency_range[1] = *range.second;
+        }
+
+        compression.implicit_indices = has_implicit_indices();
+
+        update_quantization_error(header, compression);
+    }
+
+    void HairStyle::update_quantization_error(const FileHeader& header, const CompressionHeader& compression) const {
+        const auto bounds = get_bounding_box(header);
+        // Half a step, and some slack for the float rounding when decoding.
+        const float rounding { glm::compMax(glm::abs(bounds.origin) + glm::abs(bounds.size)) *
+                               std::numeric_limits<float>::epsilon() * 2.0f };
+        quantization_error.position = compression.position_scale / 2.0f + rounding;
+        quantization_error.thickness = (compression.thickness_range[1] -
+                                        compression.thickness_range[0]) / 510.0f;
+        quantization_error.transparency = (compression.transparency_range[1] -
+                                           compression.transparency_range[0]) / 510.0f;
+
+        // Octahedral coordinates are rounded to within 0.5/127 per axis, that
+        // moves the point on the octahedron by up to sqrt(6) * 0.5/127, which
+        // is at least 1/sqrt(3) away from the origin: asin(sqrt(18) * 0.5/127)
+        // is then the largest angle to its decoded direction (~0.96 degrees).
+        quantization_error.tangent = std::asin(std::sqrt(18.0f) * 0.5f / 127.0f);
+    }
+
+    bool HairStyle::has_implicit_indices() const {
+        const auto indices = get_indices_view();
+
+        if (indices.size() != get_segment_count() * 2)
+            return false;
+
+        std::size_t index { 0 };
+        for (const auto& segment : get_segment_range()) {
+            if (index + 1 >= indices.size()) return false;
+            if (indices[index++] != segment.first_vertex)  return false;
+            if (indices[index++] != segment.second_vertex) return false;
+        }
+
+        return index == indices.size();
+    }
+
+    glm::u16vec3 HairStyle::quantize_root(const glm::vec3& root, const AABB& bounds) {
+        glm::u16vec3 quantized_root;
+
+        for (int i { 0 }; i < 3; ++i) {
+            float normalized { 0.0f };
+            if (bounds.size[i] > 0.0f) normalized = (root[i] - bounds.origin[i]) / bounds.size[i];
+            quantized_root[i] = static_cast<std::uint16_t>(std::round(glm::clamp(normalized, 0.0f, 1.0f) * 65535.0f));
+        }
+
+        return quantized_root;
+    }
+
+    glm::vec3 HairStyle::dequantize_root(const glm::u16vec3& root, const AABB& bounds) {
+        return bounds.origin + (glm::vec3 { root } / 65535.0f) * bounds.size;
+    }
+
+    // See "A Survey of Efficient Representations for Independent Unit Vectors"
+    // by Cigolle et al. (2014), directions are mapped onto the octahedron and
+    // then unfolded into a square, which gives us an even spread of precision.
+
+    glm::i8vec2 HairStyle::encode_octahedral(const glm::vec3& direction) {
+        const float norm { std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z) };
+
+        if (norm == 0.0f) return glm::i8vec2 { 0, 0 };
+
+        glm::vec2 octahedron { direction.x / norm, direction.y / norm };
+
+        if (direction.z < 0.0f) {
+            octahedron = glm::vec2 {
+                (1.0f - std::abs(octahedron.y)) * (octahedron.x >= 0.0f ? 1.0f : -1.0f),
+                (1.0f - std::abs(octahedron.x)) * (octahedron.y >= 0.0f ? 1.0f : -1.0f)
+            };
+        }
+
+        return glm::i8vec2 {
+            static_cast<std::int8_t>(std::round(glm::clamp(octahedron.x, -1.0f, 1.0f) * 127.0f)),
+            static_cast<std::int8_t>(std::round(glm::clamp(octahedron.y, -1.0f, 1.0f) * 127.0f))
+        };
+    }
+
+    glm::vec3 HairStyle::decode_octahedral(const glm::i8vec2& encoding) {
+        glm::vec3 direction {
+            encoding.x / 127.0f,
+            encoding.y / 127.0f,
+            0.0f
+        };
+
+        direction.z = 1.0f - std::abs(direction.x) - std::abs(direction.y);
+
+        if (direction.z < 0.0f) {
+            const float x { direction.x };
+            direction.x = (1.0f - std::abs(direction.y)) * (x           >= 0.0f ? 1.0f : -1.0f);
+            direction.y = (1.0f - std::abs(x))           * (direction.y >= 0.0f ? 1.0f : -1.0f);
+        }
+
+        return glm::normalize(direction);
+    }
+
     std::size_t HairStyle::get_size() const {
         std::size_t size_in_bytes { 0 };
-        size_in_bytes += segments.size() * sizeof(segments[0]);
-        size_in_bytes += vertices.size() * sizeof(vertices[0]);
-        size_in_bytes += thickness.size() * sizeof(thickness[0]);
-        size_in_bytes += color.size() * sizeof(color[0]);
-        size_in_bytes += tangents.size() * sizeof(tangents[0]);
-        size_in_bytes += indices.size() * sizeof(indices[0]);
+        size_in_bytes += get_segments_view().size() * sizeof(segments[0]);
+        size_in_bytes += get_vertices_view().size() * sizeof(vertices[0]);
+        size_in_bytes += get_thickness_view().size() * sizeof(thickness[0]);
+        size_in_bytes += get_color_view().size() * sizeof(color[0]);
+        size_in_bytes += get_tangents_view().size() * sizeof(tangents[0]);
+        size_in_bytes += get_indices_view().size() * sizeof(indices[0]);
         size_in_bytes += sizeof(FileHeader);
         return size_in_bytes;
     }
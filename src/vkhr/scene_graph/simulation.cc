@@ -1 +1,177 @@
-#include <vkhr/scene_graph/simulation.hh>
\ No newline at end of file
+#include <vkhr/scene_graph/simulation.hh>
+
+#include <vkhr/scene_graph/voxel_traversal.hh>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace vkhr {
+    IncrementalVoxelizer::IncrementalVoxelizer(const HairStyle& hair_style, const glm::ivec3& resolution) {
+        voxelize(hair_style, resolution);
+    }
+
+    void IncrementalVoxelizer::voxelize(const HairStyle& hair_style, const glm::ivec3& resolution) {
+        assert(hair_style.has_strand_offsets()); // for update() to find strands.
+
+        volume = HairStyle::SparseVolume {
+            glm::vec3 { resolution },
+            hair_style.get_bounding_box()
+        };
+
+        volume.brick_resolution = (resolution + BrickSize - 1) / BrickSize;
+        volume.brick_index.assign(volume.brick_resolution.x * volume.brick_resolution.y *
+                                  volume.brick_resolution.z, HairStyle::SparseVolume::EmptyBrick);
+
+        accumulators.clear();
+
+        voxel_size = volume.bounds.size / volume.resolution;
+
+        const auto vertices = hair_style.get_vertices_view();
+        const auto tangents = hair_style.get_tangents_view();
+
+        voxelized_vertices.assign(vertices.begin(), vertices.end());
+
+        if (tangents.size() == vertices.size())
+            voxelized_tangents.assign(tangents.begin(), tangents.end());
+        else voxelized_tangents.assign(vertices.size(), glm::vec3 { 0.0f });
+
+        dirty_strands.clear();
+        is_dirty.assign(hair_style.get_strand_count(), false);
+
+        for (const auto& strand : hair_style.get_strand_range()) {
+            voxelize_strand(strand, +1);
+            changed_voxels.clear(); // all of them are quantized below.
+        }
+
+        for (std::size_t brick { 0 }; brick < accumulators.size(); ++brick)
+        for (int voxel { 0 }; voxel < BrickVoxels; ++voxel)
+            quantize_voxel(brick, voxel);
+    }
+
+    void IncrementalVoxelizer::mark_dirty(unsigned strand) {
+        if (strand >= is_dirty.size() || is_dirty[strand])
+            return;
+        is_dirty[strand] = true;
+        dirty_strands.push_back(strand);
+    }
+
+    std::size_t IncrementalVoxelizer::get_dirty_strand_count() const {
+        return dirty_strands.size();
+    }
+
+    std::size_t IncrementalVoxelizer::update(const HairStyle& hair_style) {
+        if (hair_style.get_vertex_count() != voxelized_vertices.size() ||
+            hair_style.get_strand_count() != is_dirty.size()) {
+            voxelize(hair_style, glm::ivec3 { volume.resolution });
+            return accumulators.size() * BrickVoxels;
+        }
+
+        const auto vertices = hair_style.get_vertices_view();
+        const auto tangents = hair_style.get_tangents_view();
+
+        changed_voxels.clear();
+
+        for (const auto strand : dirty_strands) {
+            const auto range = hair_style.get_strand(strand);
+
+            voxelize_strand(range, -1);
+
+            for (auto vertex = range.first_vertex; vertex <= range.get_last_vertex(); ++vertex) {
+                voxelized_vertices[vertex] = vertices[vertex];
+                if (tangents.size() == vertices.size())
+                    voxelized_tangents[vertex] = tangents[vertex];
+            }
+
+            voxelize_strand(range, +1);
+
+            is_dirty[strand] = false;
+        }
+
+        dirty_strands.clear();
+
+        std::sort(changed_voxels.begin(), changed_voxels.end());
+        changed_voxels.erase(std::unique(changed_voxels.begin(), changed_voxels.end()), changed_voxels.end());
+
+        for (const auto voxel : changed_voxels)
+            quantize_voxel(voxel / BrickVoxels, voxel % BrickVoxels);
+
+        return changed_voxels.size();
+    }
+
+    const HairStyle::SparseVolume& IncrementalVoxelizer::get_volume() const {
+        return volume;
+    }
+
+    void IncrementalVoxelizer::voxelize_strand(const Strand& strand, int sign) {
+        const glm::ivec3 grid { volume.resolution };
+
+        for (auto vertex = strand.first_vertex; vertex < strand.get_last_vertex(); ++vertex) {
+            const auto root { (voxelized_vertices[vertex + 0] - volume.bounds.origin) / voxel_size };
+            const auto tip  { (voxelized_vertices[vertex + 1] - volume.bounds.origin) / voxel_size };
+
+            const float length { glm::length(tip - root) }; // in voxels.
+            const auto& tangent = voxelized_tangents[vertex];
+
+            traverse_voxels(root, tip, glm::ivec3 { 0 }, grid, [&](const glm::ivec3& voxel, float t_enter, float t_exit) {
+                // Same inputs give the same integers, so subtracting is exact.
+                // Round up to 1 so slivers are kept, like in the voxelizer.
+                const auto fraction = std::max(1, static_cast<std::int32_t>(std::round((t_exit - t_enter) * length * LengthUnits)));
+
+                const glm::ivec3 brick { voxel / BrickSize };
+                const glm::ivec3 local { voxel - brick * BrickSize };
+
+                const auto brick_slot = find_brick(brick);
+
+                int voxel_index = local.x + local.y*BrickSize + local.z*BrickSize*BrickSize;
+
+                accumulators[brick_slot].lengths[voxel_index]  += sign * fraction;
+                accumulators[brick_slot].tangents[voxel_index] += sign * glm::ivec3 { glm::round(tangent * static_cast<float>(fraction)) };
+
+                changed_voxels.push_back(static_cast<std::uint32_t>(brick_slot * BrickVoxels + voxel_index));
+            });
+        }
+    }
+
+    void IncrementalVoxelizer::quantize_voxel(std::size_t brick, int voxel) {
+        const auto length = accumulators[brick].lengths[voxel];
+
+        auto& density = volume.bricks[brick].densities[voxel];
+        auto& tangent = volume.bricks[brick].tangents[voxel];
+
+        if (length <= 0) {
+            density = 0;
+            tangent = glm::i8vec4 { 0, 0, 0, 0 };
+            return;
+        }
+
+        // Same units as the Exact voxelizer, the length of hair in voxels.
+        const float fixed_point { std::round(length * HairStyle::SparseVolume::DensityScale / LengthUnits) };
+        density = static_cast<std::uint16_t>(glm::clamp(fixed_point, 1.0f, 65535.0f));
+
+        glm::i8vec3 quantized = glm::vec3 { accumulators[brick].tangents[voxel] } / static_cast<float>(length) * 127.0f;
+
+        tangent.x = quantized.x;
+        tangent.y = quantized.y;
+        tangent.z = quantized.z;
+    }
+
+    std::size_t IncrementalVoxelizer::find_brick(const glm::ivec3& brick) {
+        auto& brick_slot = volume.brick_index[brick.x + brick.y*volume.brick_resolution.x +
+                                              brick.z*volume.brick_resolution.x*volume.brick_resolution.y];
+
+        if (brick_slot == HairStyle::SparseVolume::EmptyBrick) {
+            brick_slot = static_cast<unsigned>(volume.bricks.size());
+
+            volume.bricks.emplace_back();
+            volume.bricks.back().densities.fill(0);
+            volume.bricks.back().tangents.fill(glm::i8vec4 { 0, 0, 0, 0 });
+
+            accumulators.emplace_back();
+            accumulators.back().lengths.fill(0);
+            accumulators.back().tangents.fill(glm::ivec3 { 0 });
+        }
+
+        return brick_slot;
+    }
+}